@@ -0,0 +1,376 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2023 Alex Chen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * benchmark of the resizable buffer against a realloc() based vector.
+ * 
+ * build and run it from the repository root, "make bench" does the same:
+ * 
+ *     cc -O2 -I. bench/bench.c resizablebuffer.c -o rbuf_bench
+ *     ./rbuf_bench > bench_output.txt
+ * 
+ * each result is printed as one JSON object per line, e.g.
+ * 
+ *     {"impl":"rbuf","block_size":512,"metric":"append_mib_s","value":1234.5}
+ * 
+ * the metrics are:
+ *   append_mib_s       throughput of appending 32-byte records.
+ *   copy_to_p50_ns     median latency of a 64-byte read at a random offset.
+ *   copy_to_p99_ns     99th percentile of the same.
+ *   resize_grow_us     cost of growing from 0 to the buffer size in one call.
+ *   resize_shrink_us   cost of shrinking from the buffer size to 0 in one call.
+ *   overhead_per_byte  bytes requested from the allocator per stored byte,
+ *                      minus one.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "resizablebuffer.h"
+
+/* size of the buffer used in every measurement. */
+#define BENCH_BUFF_SIZE         (16 * 1024 * 1024)
+
+/* size of one appended record. */
+#define BENCH_RECORD_SIZE       32
+
+/* size of one random read. */
+#define BENCH_READ_SIZE         64
+
+/* number of random reads to collect the latency from. */
+#define BENCH_READ_NUM          200000
+
+/* times each throughput measurement is repeated, the best one is kept. */
+#define BENCH_ROUND_NUM         5
+
+/* vector baseline, it grows by doubling through realloc(). */
+typedef struct _bench_vec {
+    rbuf_u8 *data;
+    size_t size;
+    size_t cap;
+} bench_vec;
+
+/* read target the compiler can't optimize away. */
+static volatile rbuf_u8 bench_sink;
+
+/* bytes currently requested from the allocator. */
+static size_t bench_mem_live;
+
+/* random read offsets, shared by all the implementations. */
+static rbuf_u32 *bench_offs;
+
+/* latency samples of the random reads. */
+static double *bench_lat;
+
+static double bench_now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static void bench_print(const char *impl, rbuf_u32 block_size, const char *metric, double value) {
+    printf("{\"impl\":\"%s\",\"block_size\":%u,\"metric\":\"%s\",\"value\":%.3f}\n",
+           impl, block_size, metric, value);
+}
+
+static int bench_cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
+/* allocator which keeps track of the requested bytes, every allocation
+   carries its size in front of it. */
+static void *bench_alloc(void *user, size_t size) {
+    size_t *ptr;
+
+    (void)user;
+
+    ptr = (size_t *)malloc(sizeof(size_t) + size);
+    if (ptr == NULL) {
+        return NULL;
+    }
+
+    ptr[0] = size;
+    bench_mem_live += size;
+
+    return ptr + 1;
+}
+
+static void bench_free(void *user, void *ptr) {
+    size_t *base;
+
+    (void)user;
+
+    base = (size_t *)ptr - 1;
+    bench_mem_live -= base[0];
+
+    free(base);
+}
+
+static void *bench_realloc(void *user, void *ptr, size_t size) {
+    size_t *base;
+    size_t old_size;
+
+    (void)user;
+
+    if (ptr == NULL) {
+        return bench_alloc(user, size);
+    }
+
+    base = (size_t *)ptr - 1;
+    old_size = base[0];
+
+    base = (size_t *)realloc(base, sizeof(size_t) + size);
+    if (base == NULL) {
+        return NULL;
+    }
+
+    base[0] = size;
+    bench_mem_live = bench_mem_live - old_size + size;
+
+    return base + 1;
+}
+
+static rbuf_ctx *bench_rbuf_new(rbuf_u32 block_size) {
+    rbuf_ctx *ctx;
+    rbuf_conf conf;
+
+    rbuf_conf_init(&conf);
+    conf.block_size = block_size;
+    conf.size_max = 0;
+    conf.mem.alloc = bench_alloc;
+    conf.mem.realloc = bench_realloc;
+    conf.mem.free = bench_free;
+
+    if (rbuf_new(&ctx, &conf) != RBUF_OK) {
+        fprintf(stderr, "failed to create the resizable buffer\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return ctx;
+}
+
+static int bench_vec_append(bench_vec *vec, const void *buff, size_t size) {
+    rbuf_u8 *data;
+    size_t cap;
+
+    if (vec->size + size > vec->cap) {
+        cap = (vec->cap != 0) ? vec->cap : 64;
+        while (cap < vec->size + size) {
+            cap *= 2;
+        }
+
+        data = (rbuf_u8 *)bench_realloc(NULL, vec->data, cap);
+        if (data == NULL) {
+            return -1;
+        }
+
+        vec->data = data;
+        vec->cap = cap;
+    }
+
+    memcpy(vec->data + vec->size, buff, size);
+    vec->size += size;
+
+    return 0;
+}
+
+static void bench_vec_free(bench_vec *vec) {
+    if (vec->data != NULL) {
+        bench_free(NULL, vec->data);
+    }
+
+    memset(vec, 0, sizeof(bench_vec));
+}
+
+static void bench_latency(const char *impl, rbuf_u32 block_size) {
+    qsort(bench_lat, BENCH_READ_NUM, sizeof(double), bench_cmp_double);
+
+    bench_print(impl, block_size, "copy_to_p50_ns", bench_lat[BENCH_READ_NUM / 2]);
+    bench_print(impl, block_size, "copy_to_p99_ns", bench_lat[BENCH_READ_NUM / 100 * 99]);
+}
+
+static void bench_rbuf(rbuf_u32 block_size) {
+    rbuf_u8 record[BENCH_RECORD_SIZE];
+    rbuf_u8 read_buff[BENCH_READ_SIZE];
+    rbuf_ctx *ctx;
+    double best;
+    double t0;
+    double t1;
+
+    memset(record, 0x5a, sizeof(record));
+
+    /* append throughput. */
+    best = 0.0;
+    for (int round = 0; round < BENCH_ROUND_NUM; round++) {
+        ctx = bench_rbuf_new(block_size);
+
+        t0 = bench_now();
+        for (rbuf_u32 i = 0; i < BENCH_BUFF_SIZE / BENCH_RECORD_SIZE; i++) {
+            rbuf_append(ctx, record, BENCH_RECORD_SIZE);
+        }
+        t1 = bench_now();
+
+        if (round == 0 || t1 - t0 < best) {
+            best = t1 - t0;
+        }
+
+        /* memory overhead of the full buffer. */
+        if (round == 0) {
+            bench_print("rbuf", block_size, "overhead_per_byte",
+                        (double)bench_mem_live / BENCH_BUFF_SIZE - 1.0);
+        }
+
+        rbuf_del(ctx);
+    }
+    bench_print("rbuf", block_size, "append_mib_s",
+                (double)BENCH_BUFF_SIZE / (1024.0 * 1024.0) / (best / 1e9));
+
+    /* random read latency, the blocks are written first, so
+       the first touch of a page is not part of the latency. */
+    ctx = bench_rbuf_new(block_size);
+    for (rbuf_u32 i = 0; i < BENCH_BUFF_SIZE / BENCH_RECORD_SIZE; i++) {
+        rbuf_append(ctx, record, BENCH_RECORD_SIZE);
+    }
+    for (rbuf_u32 i = 0; i < BENCH_READ_NUM; i++) {
+        t0 = bench_now();
+        rbuf_copy_to(ctx, read_buff, bench_offs[i], BENCH_READ_SIZE);
+        t1 = bench_now();
+
+        bench_lat[i] = t1 - t0;
+        bench_sink = read_buff[0];
+    }
+    bench_latency("rbuf", block_size);
+    rbuf_del(ctx);
+
+    /* grow and shrink cost. */
+    ctx = bench_rbuf_new(block_size);
+    t0 = bench_now();
+    rbuf_resize(ctx, BENCH_BUFF_SIZE);
+    t1 = bench_now();
+    bench_print("rbuf", block_size, "resize_grow_us", (t1 - t0) / 1e3);
+
+    t0 = bench_now();
+    rbuf_resize(ctx, 0);
+    t1 = bench_now();
+    bench_print("rbuf", block_size, "resize_shrink_us", (t1 - t0) / 1e3);
+    rbuf_del(ctx);
+}
+
+static void bench_baseline(void) {
+    rbuf_u8 record[BENCH_RECORD_SIZE];
+    rbuf_u8 read_buff[BENCH_READ_SIZE];
+    bench_vec vec;
+    double best;
+    double t0;
+    double t1;
+
+    memset(record, 0x5a, sizeof(record));
+    memset(&vec, 0, sizeof(bench_vec));
+
+    best = 0.0;
+    for (int round = 0; round < BENCH_ROUND_NUM; round++) {
+        t0 = bench_now();
+        for (rbuf_u32 i = 0; i < BENCH_BUFF_SIZE / BENCH_RECORD_SIZE; i++) {
+            bench_vec_append(&vec, record, BENCH_RECORD_SIZE);
+        }
+        t1 = bench_now();
+
+        if (round == 0 || t1 - t0 < best) {
+            best = t1 - t0;
+        }
+
+        if (round == 0) {
+            bench_print("vector", 0, "overhead_per_byte",
+                        (double)bench_mem_live / BENCH_BUFF_SIZE - 1.0);
+        }
+
+        bench_vec_free(&vec);
+    }
+    bench_print("vector", 0, "append_mib_s",
+                (double)BENCH_BUFF_SIZE / (1024.0 * 1024.0) / (best / 1e9));
+
+    vec.data = (rbuf_u8 *)bench_alloc(NULL, BENCH_BUFF_SIZE);
+    vec.size = BENCH_BUFF_SIZE;
+    vec.cap = BENCH_BUFF_SIZE;
+    memset(vec.data, 0, BENCH_BUFF_SIZE);
+    for (rbuf_u32 i = 0; i < BENCH_READ_NUM; i++) {
+        t0 = bench_now();
+        memcpy(read_buff, vec.data + bench_offs[i], BENCH_READ_SIZE);
+        bench_sink = read_buff[0];
+        t1 = bench_now();
+
+        bench_lat[i] = t1 - t0;
+    }
+    bench_latency("vector", 0);
+    bench_vec_free(&vec);
+
+    t0 = bench_now();
+    vec.data = (rbuf_u8 *)bench_realloc(NULL, NULL, BENCH_BUFF_SIZE);
+    t1 = bench_now();
+    bench_print("vector", 0, "resize_grow_us", (t1 - t0) / 1e3);
+
+    t0 = bench_now();
+    bench_vec_free(&vec);
+    t1 = bench_now();
+    bench_print("vector", 0, "resize_shrink_us", (t1 - t0) / 1e3);
+}
+
+int main(void) {
+    rbuf_u32 block_size;
+
+    bench_offs = (rbuf_u32 *)malloc(sizeof(rbuf_u32) * BENCH_READ_NUM);
+    bench_lat = (double *)malloc(sizeof(double) * BENCH_READ_NUM);
+    if (bench_offs == NULL ||
+        bench_lat == NULL) {
+        fprintf(stderr, "failed to allocate the sample arrays\n");
+        return EXIT_FAILURE;
+    }
+
+    srand(1);
+    for (rbuf_u32 i = 0; i < BENCH_READ_NUM; i++) {
+        bench_offs[i] = (rbuf_u32)(((rbuf_u64)rand() * (RAND_MAX + 1ULL) + (rbuf_u64)rand()) %
+                                   (BENCH_BUFF_SIZE - BENCH_READ_SIZE));
+    }
+
+    bench_baseline();
+
+    /* 64 B up to 64 KiB. */
+    for (block_size = 64; block_size <= 64 * 1024; block_size *= 4) {
+        bench_rbuf(block_size);
+    }
+
+    free(bench_offs);
+    free(bench_lat);
+
+    return EXIT_SUCCESS;
+}
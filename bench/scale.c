@@ -0,0 +1,191 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2023 Alex Chen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * benchmark of the block lookup on buffers of 1 MiB up to 1 GiB, it only
+ * uses the API of the first version, so the same program measures the
+ * version built on the buffer queue and the current one.
+ * 
+ * build and run it from the repository root, "make bench-scale" does the
+ * same, and "make bench-baseline" runs it on the first version and then on
+ * the current one:
+ * 
+ *     cc -O2 -I. bench/scale.c resizablebuffer.c -o rbuf_scale
+ *     ./rbuf_scale [largest size in MiB]
+ * 
+ * each result is printed as one JSON object per line, e.g.
+ * 
+ *     {"impl":"rbuf","size_mib":16,"metric":"copy_from_s","value":0.012}
+ * 
+ * the metrics are, all with 512-byte blocks:
+ *   resize_s       growing the buffer from 0 to the size in one call.
+ *   copy_from_s    one rbuf_copy_from() of the whole buffer.
+ *   copy_to_s      one rbuf_copy_to() of the whole buffer.
+ *   rand_s         10000 rbuf_copy_to() of 64 bytes at random offsets.
+ * 
+ * the whole-buffer copies leave out the last byte, as the first version
+ * read one block past the end of a range ending on a block boundary.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "resizablebuffer.h"
+
+/* name of the measured version in the results. */
+#ifndef SCALE_IMPL
+#define SCALE_IMPL              "rbuf"
+#endif
+
+/* block size of every buffer. */
+#define SCALE_BLOCK_SIZE        512
+
+/* size of one random read. */
+#define SCALE_READ_SIZE         64
+
+/* number of random reads. */
+#define SCALE_READ_NUM          10000
+
+/* buffer sizes in MiB, up to the largest one asked for. */
+static const rbuf_u32 scale_sizes[] = {1, 16, 256, 1024};
+
+/* read target the compiler can't optimize away. */
+static volatile rbuf_u8 scale_sink;
+
+static double scale_now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void scale_print(rbuf_u32 size_mib, const char *metric, double value) {
+    printf("{\"impl\":\"%s\",\"size_mib\":%u,\"metric\":\"%s\",\"value\":%.3f}\n",
+           SCALE_IMPL, size_mib, metric, value);
+    fflush(stdout);
+}
+
+static void scale_check(rbuf_res res, const char *what) {
+    if (res != RBUF_OK) {
+        fprintf(stderr, "%s failed: %d\n", what, (int)res);
+        exit(EXIT_FAILURE);
+    }
+}
+
+static void scale_run(rbuf_u32 size_mib, rbuf_u8 *data, rbuf_u8 *back) {
+    rbuf_u8 read_buff[SCALE_READ_SIZE];
+    rbuf_u32 size;
+    rbuf_ctx *ctx;
+    rbuf_conf conf;
+    rbuf_u32 offs;
+    double t0;
+    double t1;
+
+    size = size_mib * 1024 * 1024;
+
+    memset(&conf, 0, sizeof(rbuf_conf));
+    conf.block_size = SCALE_BLOCK_SIZE;
+    conf.size_max = 0;
+    scale_check(rbuf_new(&ctx, &conf), "rbuf_new()");
+
+    t0 = scale_now();
+    scale_check(rbuf_resize(ctx, size), "rbuf_resize()");
+    t1 = scale_now();
+    scale_print(size_mib, "resize_s", t1 - t0);
+
+    t0 = scale_now();
+    scale_check(rbuf_copy_from(ctx, data, 0, size - 1), "rbuf_copy_from()");
+    t1 = scale_now();
+    scale_print(size_mib, "copy_from_s", t1 - t0);
+
+    t0 = scale_now();
+    scale_check(rbuf_copy_to(ctx, back, 0, size - 1), "rbuf_copy_to()");
+    t1 = scale_now();
+    scale_print(size_mib, "copy_to_s", t1 - t0);
+
+    if (memcmp(data, back, size - 1) != 0) {
+        fprintf(stderr, "the data read back differs\n");
+        exit(EXIT_FAILURE);
+    }
+
+    srand(1);
+    t0 = scale_now();
+    for (rbuf_u32 i = 0; i < SCALE_READ_NUM; i++) {
+        offs = (rbuf_u32)(((rbuf_u64)rand() * ((rbuf_u64)RAND_MAX + 1) + (rbuf_u64)rand()) %
+                          (size - SCALE_READ_SIZE));
+        scale_check(rbuf_copy_to(ctx, read_buff, offs, SCALE_READ_SIZE), "rbuf_copy_to()");
+        scale_sink = read_buff[0];
+    }
+    t1 = scale_now();
+    scale_print(size_mib, "rand_s", t1 - t0);
+
+    rbuf_del(ctx);
+}
+
+int main(int argc, char *argv[]) {
+    rbuf_u32 size_mib_max;
+    rbuf_u8 *data;
+    rbuf_u8 *back;
+
+    size_mib_max = 1024;
+    if (argc > 1) {
+        size_mib_max = (rbuf_u32)strtoul(argv[1], NULL, 10);
+    }
+
+    /* the first version has 32-bit sizes. */
+    if (size_mib_max == 0 ||
+        size_mib_max > 1024) {
+        fprintf(stderr, "the largest size must be 1 to 1024 MiB\n");
+        return EXIT_FAILURE;
+    }
+
+    data = (rbuf_u8 *)malloc((size_t)size_mib_max * 1024 * 1024);
+    back = (rbuf_u8 *)malloc((size_t)size_mib_max * 1024 * 1024);
+    if (data == NULL ||
+        back == NULL) {
+        fprintf(stderr, "failed to allocate the data arrays\n");
+        return EXIT_FAILURE;
+    }
+
+    for (size_t i = 0; i < (size_t)size_mib_max * 1024 * 1024; i++) {
+        data[i] = (rbuf_u8)(i * 131 + 7);
+    }
+    memset(back, 0, (size_t)size_mib_max * 1024 * 1024);
+
+    for (size_t i = 0; i < sizeof(scale_sizes) / sizeof(scale_sizes[0]); i++) {
+        if (scale_sizes[i] <= size_mib_max) {
+            scale_run(scale_sizes[i], data, back);
+        }
+    }
+
+    free(data);
+    free(back);
+
+    return EXIT_SUCCESS;
+}
@@ -22,353 +22,5988 @@
  * SOFTWARE.
  */
 
+/* mremap() is an extension of Linux. */
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "resizablebuffer.h"
-#include "bufferqueue.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+
+#include <errno.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define RBUF_HAS_MMAP
+#define RBUF_HAS_PTHREAD
+#define RBUF_HAS_MEMALIGN
+
+#ifdef MREMAP_MAYMOVE
+#define RBUF_HAS_MREMAP
+#endif
+
+#ifdef MADV_HUGEPAGE
+#define RBUF_HAS_HUGE_PAGE
+#endif
+
+#ifdef __linux__
+
+#include <sys/sendfile.h>
+
+#define RBUF_HAS_SENDFILE
+
+#endif
+
+#endif
+
+/* CRC-32C instructions, SSE 4.2 is checked at run time. */
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+
+#define RBUF_HAS_CRC32C_SSE42
+
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+
+#include <arm_acle.h>
+
+#define RBUF_HAS_CRC32C_ARM
+
+#endif
+
+#if !defined(__STDC_NO_ATOMICS__) && __STDC_VERSION__ >= 201112L
+
+#include <stdatomic.h>
+
+#define RBUF_HAS_ATOMICS
+
+#endif
+
+/* the block recycler keeps its free lists in thread-local storage. */
+#if defined(RBUF_HAS_PTHREAD) && defined(RBUF_HAS_ATOMICS) && !defined(__STDC_NO_THREADS__)
+
+#define RBUF_HAS_RECYCLE
+
+#endif
 
 /* default block size of the resizable buffer. */
+#ifdef RBUF_BLOCK_SHIFT
+
+/* the block size can be fixed at compile time as a power of two, then
+   the offset to block conversion doesn't depend on the context at all. */
+#define RBUF_DEF_BLOCK_SIZE     ((rbuf_u32)1 << RBUF_BLOCK_SHIFT)
+
+#else
+
 #define RBUF_DEF_BLOCK_SIZE     512
 
+#endif
+
 /* default maximum size of the resizable buffer. */
 #define RBUF_DEF_SIZE_MAX       1024
 
+/* default number of blocks in one slab chunk. */
+#define RBUF_DEF_SLAB_BLOCK_NUM 1
+
+/* largest buffer size, it leaves room for the consumed
+   part of the first block so offsets never wrap around. */
+#define RBUF_SIZE_LIMIT         (UINT64_MAX - UINT32_MAX)
+
+/* initial slot number of the block index table. */
+#define RBUF_DEF_TAB_CAP        8
+
+/* number of scatter/gather elements handed to one readv() or writev(). */
+#define RBUF_IOV_NUM            64
+
+/* snapshot written by rbuf_save(), its header size, magic and version. */
+#define RBUF_SNAP_HDR_SIZE      32
+#define RBUF_SNAP_MAGIC         "RBUF"
+#define RBUF_SNAP_VERSION       1
+
+/* most parts rbuf_copy_from_parallel() hands to the executor, and the
+   smallest part, smaller copying isn't worth another thread. */
+#define RBUF_PARALLEL_MAX       64
+#define RBUF_PARALLEL_PART_MIN  (256 * 1024)
+
+/* size classes of the block recycler, the chunks each thread keeps in one
+   class, the chunks moved to or from the depot at once, and the chunks the
+   depot keeps in one class, the ones beyond are freed. */
+#define RBUF_RECYCLE_CLASS_NUM  8
+#define RBUF_RECYCLE_THREAD_MAX 64
+#define RBUF_RECYCLE_BATCH      32
+#define RBUF_RECYCLE_DEPOT_MAX  4096
+
+/* size of a transparent huge page, the chunks of at least
+   this size are aligned to it in the huge-page mode. */
+#define RBUF_HUGE_PAGE_SIZE     ((size_t)2 * 1024 * 1024)
+
+/* largest block alignment reported by rbuf_status64(). */
+#define RBUF_ALIGN_MAX          ((rbuf_u32)1 << 31)
+
+/* assumed cache line size, used to keep the fields of
+   different threads away from each other. */
+#define RBUF_CACHE_LINE_SIZE    64
+
+/* whether the context is in the single-producer/single-consumer mode. */
+#define RBUF_IS_SPSC(ctx)       (((ctx)->conf.flags & RBUF_FLAG_SPSC) != 0)
+
+/* whether the block sizes of the context grow geometrically. */
+#define RBUF_IS_ADAPTIVE(ctx)   ((ctx)->conf.grow_num != 0)
+
+/* whether the only block of the context is the inline one. */
+#if RBUF_INLINE_SIZE > 0
+#define RBUF_IS_INLINE(ctx)     ((ctx)->cache.inline_used)
+#else
+#define RBUF_IS_INLINE(ctx)     false
+#endif
+
+/* whether the blocks of the context live in a memory mapping. */
+#define RBUF_IS_MMAP(ctx)       (((ctx)->conf.flags & RBUF_FLAG_MMAP) != 0)
+
+/* whether the slab chunks of the context carry a reference count. */
+#define RBUF_IS_SHARED(ctx)     (((ctx)->conf.flags & RBUF_FLAG_SHARED) != 0)
+
+/* whether the blocks of the context are allocated with a chosen alignment,
+   the address returned by the allocator is kept in front of each chunk. */
+#define RBUF_IS_ALIGNED(ctx)    ((ctx)->conf.block_align != 0 || \
+                                 ((ctx)->conf.flags & RBUF_FLAG_HUGE_PAGE) != 0)
+
+/* whether the freed slab chunks of the context go to the block recycler. */
+#define RBUF_IS_RECYCLED(ctx)   (((ctx)->conf.flags & RBUF_FLAG_RECYCLE) != 0)
+
+/* whether the copying of the context may run on several threads at once. */
+#define RBUF_IS_CONCURRENT(ctx) (((ctx)->conf.flags & RBUF_FLAG_CONCURRENT) != 0)
+
+/* check whether the CRC-32C of each block is kept. */
+#define RBUF_IS_SUMMED(ctx)     (((ctx)->conf.flags & RBUF_FLAG_CHECKSUM) != 0)
+
+/* update a counter of the context, it costs nothing unless RBUF_STATS is defined. */
+#ifdef RBUF_STATS
+#define RBUF_STAT_ADD(ctx, name, num)   ((ctx)->stats.name += (num))
+#else
+#define RBUF_STAT_ADD(ctx, name, num)   ((void)0)
+#endif
+
+/* update a counter of the copying, the copying in the concurrent
+   mode isn't counted, since the counters aren't atomic. */
+#define RBUF_STAT_COPY(ctx, name, num)  \
+    (RBUF_IS_CONCURRENT(ctx) ? (void)0 : (void)RBUF_STAT_ADD(ctx, name, num))
+
+/* header in front of each slab chunk in the shared mode, it takes up the
+   strictest alignment, so the blocks after it stay aligned. */
+typedef union _rbuf_share_hdr {
+#ifdef RBUF_HAS_ATOMICS
+    _Atomic rbuf_u32 refs;
+#else
+    rbuf_u32 refs;
+#endif
+    rbuf_u64 align_u64;
+    long double align_ld;
+    void *align_ptr;
+} rbuf_share_hdr;
+
+/* CRC-32C of the bytes [from, to) of a block, none
+   of its bytes is hashed when "from" equals "to". */
+typedef struct _rbuf_sum {
+    rbuf_u32 crc;
+    rbuf_u32 from;
+    rbuf_u32 to;
+} rbuf_sum;
+
 /* context of the resizable buffer. */
+#ifdef RBUF_HAS_ATOMICS
+
+/* ring indices of the single-producer/single-consumer mode, each on a
+   cache line of its own, so the two sides don't share one. */
+typedef struct _rbuf_spsc_idx {
+
+    /* number of bytes produced but not consumed yet, the producer
+       adds to it and the consumer subtracts from it. */
+    _Atomic rbuf_u32 size;
+    rbuf_u8 pad_0[RBUF_CACHE_LINE_SIZE - sizeof(_Atomic rbuf_u32)];
+
+    /* ring offset of the next byte to produce, owned by the producer. */
+    rbuf_u32 tail;
+    rbuf_u8 pad_1[RBUF_CACHE_LINE_SIZE - sizeof(rbuf_u32)];
+
+    /* ring offset of the next byte to consume, owned by the consumer. */
+    rbuf_u32 head;
+    rbuf_u8 pad_2[RBUF_CACHE_LINE_SIZE - sizeof(rbuf_u32)];
+} rbuf_spsc_idx;
+
+#endif
+
 struct _rbuf_ctx {
-    bque_ctx *bque;
     struct _rbuf_ctx_conf {
 
         /* block size of the resizable buffer. */
         rbuf_u32 block_size;
 
+        /* when the block size is a power of two, the offset to block
+           conversion uses the shift and the mask instead of a division. */
+        bool block_pow2;
+        rbuf_u32 block_shift;
+        rbuf_u32 block_mask;
+
+        /* in the adaptive mode, the block sizes double "grow_num" times
+           from "block_size" up to "1 << block_shift_max", so the first
+           "grow_num" blocks take up "grow_size" bytes in total. */
+        rbuf_u32 grow_num;
+        rbuf_u32 block_shift_max;
+        rbuf_u64 grow_size;
+
         /* maximum size of the resizable buffer,
            when it is 0, it means no limit. */
-        rbuf_u32 size_max;
+        rbuf_u64 size_max;
+
+        /* number of blocks allocated together as one slab chunk. */
+        rbuf_u32 slab_block_num;
+
+        /* allocator of the context, the block index table and the blocks. */
+        rbuf_mem mem;
+
+        /* bitwise OR of the "RBUF_FLAG_*" flags. */
+        rbuf_u32 flags;
+
+        /* alignment of each block, 0 leaves it to the allocator. */
+        rbuf_u32 block_align;
+
+        /* watermarks of the spare slab chunks. */
+        rbuf_u32 spare_low;
+        rbuf_u32 spare_high;
     } conf;
+    struct _rbuf_ctx_tab {
+
+        /* memory of the table, the slots released from the
+           front stay here until the table is compacted. */
+        rbuf_u8 **base;
+
+        /* block pointers, indexed by the block number,
+           so any block can be resolved in O(1). */
+        rbuf_u8 **blocks;
+
+        /* slot number of the table, it never shrinks. */
+        rbuf_u32 cap;
+
+        /* position of the first block inside its slab chunk. */
+        rbuf_u32 phase;
+
+        /* whether the table memory belongs to the context or the block
+           pool instead of the allocator, it is copied when it grows. */
+        bool borrowed;
+
+        /* in the adaptive mode, the number of the first block counted
+           from the first block ever added, and where the first block
+           starts in that count, they pick the size of each block. */
+        rbuf_u64 first_no;
+        rbuf_u64 first_pos;
+    } tab;
+    struct _rbuf_ctx_pool {
+
+        /* blocks carved from the caller-supplied pool, the free ones
+           are linked through their first bytes. */
+        rbuf_u8 *base;
+        rbuf_u8 *end;
+        rbuf_u8 *free;
+    } pool;
+    struct _rbuf_ctx_spare {
+
+        /* slab chunks released by shrinking, kept for the next growth,
+           the array holds up to "spare_high" chunks. */
+        rbuf_u8 **chunks;
+        rbuf_u32 num;
+    } spare;
     struct _rbuf_ctx_cache {
         rbuf_u32 block_num;
-        rbuf_u32 buff_cap;
-        rbuf_u32 buff_size;
-        rbuf_u32 last_block_buff_size;
+        rbuf_u64 buff_cap;
+        rbuf_u64 buff_size;
+
+        /* offset of the first byte inside the first block,
+           it moves forward as the data is consumed. */
+        rbuf_u32 head_offs;
+
+        /* where the next appended byte goes, and how many bytes can be
+           appended there without crossing a block or the maximum size. */
+        rbuf_u8 *tail_ptr;
+        rbuf_u32 tail_rest;
+
+        /* whether some of the blocks may be shared with other contexts,
+           they are copied before they are written then. */
+        bool shared;
+
+        /* largest power of two dividing the address of every block added
+           since the buffer was last empty, 0 before the first one. */
+        rbuf_u32 block_align;
+#if RBUF_INLINE_SIZE > 0
+
+        /* whether the only block is the inline one, it is smaller
+           than the other blocks, and it is never freed. */
+        bool inline_used;
+#endif
     } cache;
+#if RBUF_INLINE_SIZE > 0
+    struct _rbuf_ctx_inl {
+
+        /* table slot used until the table is allocated, and
+           the memory of the inline block. */
+        rbuf_u8 *slot;
+        rbuf_u8 buff[RBUF_INLINE_SIZE];
+    } inl;
+#endif
+    struct _rbuf_ctx_lin {
+
+        /* contiguous copy of the range [offs, offs + size) made by
+           rbuf_linearize(), it is dropped once the range is written,
+           and "size" being 0 means there is no copy. */
+        rbuf_u8 *buff;
+        size_t cap;
+        rbuf_u64 offs;
+        rbuf_u64 size;
+    } lin;
+    struct _rbuf_ctx_sum {
+
+        /* CRC-32C of each block in the "RBUF_FLAG_CHECKSUM" mode, indexed
+           like the slots of the block index table, so the blocks keep
+           theirs as long as they keep their slots. */
+        rbuf_sum *slots;
+        rbuf_u32 cap;
+    } sum;
+#ifdef RBUF_STATS
+
+    /* counters reported by rbuf_status_ext(). */
+    rbuf_counters stats;
+#endif
+#ifdef RBUF_HAS_MMAP
+    struct _rbuf_ctx_map {
+
+        /* mapping of the block slots, the block of the slot "n" is at
+           the offset "n * block_size", both in the mapping and the file. */
+        rbuf_u8 *base;
+        rbuf_u32 slot_num;
+
+        /* backing file, or -1 for anonymous memory. */
+        int fd;
+
+        /* page size, only the pages fully covered
+           by the released blocks are given back. */
+        size_t page_size;
+    } map;
+#endif
+#ifdef RBUF_HAS_ATOMICS
+    struct _rbuf_ctx_spsc {
+
+        /* ring length, the blocks are never added or released. */
+        rbuf_u32 ring_len;
+
+        /* ring indices, aligned to a cache line inside
+           "mem", which is allocated along with the ring. */
+        rbuf_spsc_idx *idx;
+        void *mem;
+    } spsc;
+#endif
 };
 
+#ifndef RBUF_BLOCK_SHIFT
+
+/**
+ * @brief get the index of the highest bit set.
+ * 
+ * @param val value, it isn't 0.
+*/
+static inline rbuf_u32 rbuf_log2(rbuf_u64 val) {
+#if defined(__GNUC__) || defined(__clang__)
+    return 63 - (rbuf_u32)__builtin_clzll(val);
+#else
+    rbuf_u32 bit_idx;
+
+    bit_idx = 0;
+    while ((val >> 1) != 0) {
+        val >>= 1;
+        bit_idx++;
+    }
+
+    return bit_idx;
+#endif
+}
+
+/**
+ * @brief get where the block "no" starts in the adaptive mode,
+ *        counted from the first block ever added.
+ * 
+ * @param ctx context pointer.
+ * @param no block number.
+*/
+static inline rbuf_u64 rbuf_geo_start(const rbuf_ctx *ctx, rbuf_u64 no) {
+    if (no < ctx->conf.grow_num) {
+        return ((rbuf_u64)ctx->conf.block_size << no) - ctx->conf.block_size;
+    }
+
+    return ctx->conf.grow_size + ((no - ctx->conf.grow_num) << ctx->conf.block_shift_max);
+}
+
+/**
+ * @brief get the number of the block holding the specified position
+ *        in the adaptive mode, in O(1) without walking the blocks.
+ * 
+ * @param ctx context pointer.
+ * @param pos position counted from the first block ever added.
+*/
+static inline rbuf_u64 rbuf_geo_no(const rbuf_ctx *ctx, rbuf_u64 pos) {
+
+    /* the block "no" of the growing part starts at
+       "block_size * (2^no - 1)", so "no" is a logarithm. */
+    if (pos < ctx->conf.grow_size) {
+        return rbuf_log2((pos >> ctx->conf.block_shift) + 1);
+    }
+
+    return ctx->conf.grow_num + ((pos - ctx->conf.grow_size) >> ctx->conf.block_shift_max);
+}
+
+#endif
+
+/**
+ * @brief get the index of the block holding the specified offset,
+ *        the consumed part of the first block is taken into account.
+ * 
+ * @param ctx context pointer.
+ * @param offs offset in the resizable buffer.
+*/
+static inline rbuf_u64 rbuf_block_idx(const rbuf_ctx *ctx, rbuf_u64 offs) {
+    offs += ctx->cache.head_offs;
+
+#ifdef RBUF_BLOCK_SHIFT
+    return offs >> RBUF_BLOCK_SHIFT;
+#else
+    if (RBUF_IS_ADAPTIVE(ctx)) {
+        return rbuf_geo_no(ctx, ctx->tab.first_pos + offs) - ctx->tab.first_no;
+    }
+
+    if (ctx->conf.block_pow2) {
+        return offs >> ctx->conf.block_shift;
+    }
+
+    return offs / ctx->conf.block_size;
+#endif
+}
+
+/**
+ * @brief get the offset inside the block holding the specified offset,
+ *        the consumed part of the first block is taken into account.
+ * 
+ * @param ctx context pointer.
+ * @param offs offset in the resizable buffer.
+*/
+static inline rbuf_u32 rbuf_block_offs(const rbuf_ctx *ctx, rbuf_u64 offs) {
+    offs += ctx->cache.head_offs;
+
+#ifdef RBUF_BLOCK_SHIFT
+    return (rbuf_u32)(offs & (RBUF_DEF_BLOCK_SIZE - 1));
+#else
+    if (RBUF_IS_ADAPTIVE(ctx)) {
+        offs += ctx->tab.first_pos;
+
+        return (rbuf_u32)(offs - rbuf_geo_start(ctx, rbuf_geo_no(ctx, offs)));
+    }
+
+    if (ctx->conf.block_pow2) {
+        return (rbuf_u32)(offs & ctx->conf.block_mask);
+    }
+
+    return (rbuf_u32)(offs % ctx->conf.block_size);
+#endif
+}
+
+/**
+ * @brief get the size of the specified block.
+ * 
+ * @param ctx context pointer.
+ * @param block_idx block index.
+*/
+static inline rbuf_u32 rbuf_block_size(const rbuf_ctx *ctx, rbuf_u64 block_idx) {
+    if (RBUF_IS_INLINE(ctx)) {
+        return RBUF_INLINE_SIZE;
+    }
+
+#ifdef RBUF_BLOCK_SHIFT
+    (void)block_idx;
+
+    return ctx->conf.block_size;
+#else
+    rbuf_u64 no;
+
+    if (!RBUF_IS_ADAPTIVE(ctx)) {
+        return ctx->conf.block_size;
+    }
+
+    no = ctx->tab.first_no + block_idx;
+    if (no < ctx->conf.grow_num) {
+        return ctx->conf.block_size << no;
+    }
+
+    return (rbuf_u32)1 << ctx->conf.block_shift_max;
+#endif
+}
+
+/**
+ * @brief get the buffer capacity of the specified number of blocks,
+ *        the consumed part of the first block is taken into account.
+ * 
+ * @param ctx context pointer.
+ * @param block_num number of blocks.
+*/
+static inline rbuf_u64 rbuf_block_cap(const rbuf_ctx *ctx, rbuf_u32 block_num) {
+    if (RBUF_IS_INLINE(ctx)) {
+        return RBUF_INLINE_SIZE - ctx->cache.head_offs;
+    }
+
+#ifndef RBUF_BLOCK_SHIFT
+    if (RBUF_IS_ADAPTIVE(ctx)) {
+        return rbuf_geo_start(ctx, ctx->tab.first_no + block_num) -
+               ctx->tab.first_pos - ctx->cache.head_offs;
+    }
+#endif
+
+    return (rbuf_u64)ctx->conf.block_size * block_num - ctx->cache.head_offs;
+}
+
+/**
+ * @brief get the size from the specified offset to the end of the block
+ *        "block_num - 1" blocks after the one holding it, as if the blocks
+ *        were there, and not counting the inline block.
+ * 
+ * @param ctx context pointer.
+ * @param offs offset in the resizable buffer.
+ * @param block_num number of blocks, 1 or more.
+*/
+static inline rbuf_u64 rbuf_block_reach(const rbuf_ctx *ctx, rbuf_u64 offs, rbuf_u32 block_num) {
+#ifndef RBUF_BLOCK_SHIFT
+    rbuf_u64 pos;
+
+    if (RBUF_IS_ADAPTIVE(ctx)) {
+        pos = ctx->tab.first_pos + ctx->cache.head_offs + offs;
+
+        return rbuf_geo_start(ctx, rbuf_geo_no(ctx, pos) + block_num) - pos;
+    }
+#endif
+
+    return (rbuf_u64)ctx->conf.block_size * block_num - rbuf_block_offs(ctx, offs);
+}
+
+static void *rbuf_def_alloc(void *user, size_t size) {
+    (void)user;
+
+    return malloc(size);
+}
+
+static void *rbuf_def_realloc(void *user, void *ptr, size_t size) {
+    (void)user;
+
+    return realloc(ptr, size);
+}
+
+static void rbuf_def_free(void *user, void *ptr) {
+    (void)user;
+
+    free(ptr);
+}
+
+/**
+ * @brief reallocate memory through the allocator of the context.
+ * 
+ * @param ctx context pointer.
+ * @param ptr memory to reallocate, it can be NULL.
+ * @param old_size the current size of the memory.
+ * @param new_size the new size of the memory.
+*/
+static void *rbuf_mem_realloc(rbuf_ctx *ctx, void *ptr, size_t old_size, size_t new_size) {
+    void *alloc_ptr;
+
+    if (ctx->conf.mem.realloc != NULL) {
+        return ctx->conf.mem.realloc(ctx->conf.mem.user, ptr, new_size);
+    }
+
+    /* the allocator can't grow memory in place,
+       so move the content into a new memory. */
+    alloc_ptr = ctx->conf.mem.alloc(ctx->conf.mem.user, new_size);
+    if (alloc_ptr == NULL) {
+        return NULL;
+    }
+
+    if (ptr != NULL) {
+        memcpy(alloc_ptr, ptr, (old_size < new_size) ? old_size : new_size);
+        ctx->conf.mem.free(ctx->conf.mem.user, ptr);
+    }
+
+    return alloc_ptr;
+}
+
+/**
+ * @brief get the alignment of a slab chunk in the aligned mode, in the
+ *        huge-page mode a chunk of at least a huge page is aligned to it.
+ * 
+ * @param ctx context pointer.
+ * @param size chunk size.
+*/
+static size_t rbuf_chunk_align(const rbuf_ctx *ctx, size_t size) {
+    size_t align;
+
+    align = (ctx->conf.block_align > sizeof(rbuf_u8 *)) ? ctx->conf.block_align : sizeof(rbuf_u8 *);
+    if ((ctx->conf.flags & RBUF_FLAG_HUGE_PAGE) != 0 &&
+        size >= RBUF_HUGE_PAGE_SIZE &&
+        align < RBUF_HUGE_PAGE_SIZE) {
+        align = RBUF_HUGE_PAGE_SIZE;
+    }
+
+    return align;
+}
+
+#ifdef RBUF_HAS_HUGE_PAGE
+
+/**
+ * @brief get the size of the mapping of a slab chunk aligned to a huge page,
+ *        and the room for the header in front of the chunk.
+ * 
+ * @param size chunk size.
+ * @param head size of the header in front of the chunk.
+ * @param head_room the address of the room for the header.
+ * @return the mapping size, or 0 when it needs more than the address space.
+*/
+static size_t rbuf_huge_map_size(size_t size, size_t head, size_t *head_room) {
+    long page_size;
+    size_t page;
+
+    page_size = sysconf(_SC_PAGESIZE);
+    page = (page_size > 0) ? (size_t)page_size : 4096;
+
+    *head_room = (head + page - 1) / page * page;
+    if (size > SIZE_MAX - *head_room - page - RBUF_HUGE_PAGE_SIZE) {
+        return 0;
+    }
+
+    return (*head_room + size + page - 1) / page * page;
+}
+
+/**
+ * @brief map a slab chunk aligned to a huge page, with no padding left.
+ * 
+ * @param size chunk size.
+ * @param head size of the header in front of the chunk.
+*/
+static rbuf_u8 *rbuf_huge_map(size_t size, size_t head) {
+    rbuf_u8 *map_ptr;
+    rbuf_u8 *base;
+    size_t map_size;
+    size_t head_room;
+    size_t lead;
+
+    map_size = rbuf_huge_map_size(size, head, &head_room);
+    if (map_size == 0) {
+        return NULL;
+    }
+
+    map_ptr = (rbuf_u8 *)mmap(NULL, map_size + RBUF_HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+                              MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (map_ptr == (rbuf_u8 *)MAP_FAILED) {
+        return NULL;
+    }
+
+    base = map_ptr + head_room;
+    lead = (RBUF_HUGE_PAGE_SIZE - (uintptr_t)base % RBUF_HUGE_PAGE_SIZE) % RBUF_HUGE_PAGE_SIZE;
+    base += lead - head_room;
+
+    if (lead != 0) {
+        munmap(map_ptr, lead);
+    }
+
+    if (lead != RBUF_HUGE_PAGE_SIZE) {
+        munmap(base + map_size, RBUF_HUGE_PAGE_SIZE - lead);
+    }
+
+    /* only the whole huge pages can be backed by one, it is just a hint. */
+    madvise(base + head_room, size - size % RBUF_HUGE_PAGE_SIZE, MADV_HUGEPAGE);
+
+    return base + head_room;
+}
+
+/**
+ * @brief unmap a slab chunk mapped by rbuf_huge_map().
+ * 
+ * @param chunk chunk pointer.
+ * @param size chunk size.
+ * @param head size of the header in front of the chunk.
+*/
+static void rbuf_huge_unmap(rbuf_u8 *chunk, size_t size, size_t head) {
+    size_t map_size;
+    size_t head_room;
+
+    map_size = rbuf_huge_map_size(size, head, &head_room);
+    munmap(chunk - head_room, map_size);
+}
+
+#endif
+
+/**
+ * @brief allocate the memory of a slab chunk aligned for the blocks.
+ * 
+ * @param ctx context pointer.
+ * @param size chunk size.
+ * @param head size of the header in front of the chunk.
+ * @return the chunk, the header is right in front of it.
+*/
+static rbuf_u8 *rbuf_mem_alloc_chunk(rbuf_ctx *ctx, size_t size, size_t head) {
+    rbuf_u8 *alloc_ptr;
+    rbuf_u8 *chunk;
+    size_t align;
+
+    if (!RBUF_IS_ALIGNED(ctx)) {
+        if (size > SIZE_MAX - head) {
+            return NULL;
+        }
+
+        alloc_ptr = (rbuf_u8 *)ctx->conf.mem.alloc(ctx->conf.mem.user, head + size);
+
+        return (alloc_ptr != NULL) ? alloc_ptr + head : NULL;
+    }
+
+    align = rbuf_chunk_align(ctx, size);
+
+#ifdef RBUF_HAS_HUGE_PAGE
+    if (ctx->conf.mem.alloc == rbuf_def_alloc &&
+        align == RBUF_HUGE_PAGE_SIZE) {
+        return rbuf_huge_map(size, head);
+    }
+#endif
+
+#ifdef RBUF_HAS_MEMALIGN
+
+    /* the header, if any, takes a whole alignment in front of the chunk. */
+    if (ctx->conf.mem.alloc == rbuf_def_alloc) {
+        head = (head + align - 1) / align * align;
+        if (size > SIZE_MAX - head ||
+            posix_memalign((void **)&alloc_ptr, align, head + size) != 0) {
+            return NULL;
+        }
+
+        return alloc_ptr + head;
+    }
+#endif
+
+    /* room for the header, the address to free and the padding. */
+    if (size > SIZE_MAX - head - sizeof(rbuf_u8 *) - (align - 1)) {
+        return NULL;
+    }
+
+    alloc_ptr = (rbuf_u8 *)ctx->conf.mem.alloc(ctx->conf.mem.user,
+                                               head + sizeof(rbuf_u8 *) + (align - 1) + size);
+    if (alloc_ptr == NULL) {
+        return NULL;
+    }
+
+    chunk = alloc_ptr + head + sizeof(rbuf_u8 *);
+    chunk += (align - (uintptr_t)chunk % align) % align;
+    memcpy(chunk - head - sizeof(rbuf_u8 *), &alloc_ptr, sizeof(rbuf_u8 *));
+
+#ifdef RBUF_HAS_HUGE_PAGE
+    if (align == RBUF_HUGE_PAGE_SIZE) {
+        madvise(chunk, size - size % RBUF_HUGE_PAGE_SIZE, MADV_HUGEPAGE);
+    }
+#endif
+
+    return chunk;
+}
+
+/**
+ * @brief free the memory of a slab chunk allocated by rbuf_mem_alloc_chunk().
+ * 
+ * @param ctx context pointer.
+ * @param chunk chunk pointer.
+ * @param size chunk size.
+ * @param head size of the header in front of the chunk.
+*/
+static void rbuf_mem_free_chunk(rbuf_ctx *ctx, rbuf_u8 *chunk, size_t size, size_t head) {
+    rbuf_u8 *alloc_ptr;
+#ifdef RBUF_HAS_MEMALIGN
+    size_t align;
+#endif
+
+    if (!RBUF_IS_ALIGNED(ctx)) {
+        ctx->conf.mem.free(ctx->conf.mem.user, chunk - head);
+
+        return;
+    }
+
+#ifdef RBUF_HAS_MEMALIGN
+    if (ctx->conf.mem.alloc == rbuf_def_alloc) {
+        align = rbuf_chunk_align(ctx, size);
+#ifdef RBUF_HAS_HUGE_PAGE
+        if (align == RBUF_HUGE_PAGE_SIZE) {
+            rbuf_huge_unmap(chunk, size, head);
+
+            return;
+        }
+#endif
+
+        free(chunk - (head + align - 1) / align * align);
+
+        return;
+    }
+#else
+    (void)size;
+#endif
+
+    memcpy(&alloc_ptr, chunk - head - sizeof(rbuf_u8 *), sizeof(rbuf_u8 *));
+    ctx->conf.mem.free(ctx->conf.mem.user, alloc_ptr);
+}
+
+/**
+ * @brief take the alignment of a new block into account.
+ * 
+ * @param ctx context pointer.
+ * @param block block pointer.
+*/
+static inline void rbuf_align_note(rbuf_ctx *ctx, const rbuf_u8 *block) {
+    uintptr_t addr;
+    rbuf_u32 align;
+
+    addr = (uintptr_t)block | RBUF_ALIGN_MAX;
+    align = (rbuf_u32)(addr & (~addr + 1));
+    if (ctx->cache.block_align == 0 ||
+        align < ctx->cache.block_align) {
+        ctx->cache.block_align = align;
+    }
+}
+
+/**
+ * @brief get the CRC-32C of the specified block.
+ * 
+ * @param ctx context pointer.
+ * @param block_idx block index.
+*/
+static inline rbuf_sum *rbuf_sum_of(const rbuf_ctx *ctx, rbuf_u32 block_idx) {
+    return ctx->sum.slots + (size_t)(ctx->tab.blocks - ctx->tab.base) + block_idx;
+}
+
+/**
+ * @brief make the CRC-32C array as large as the block index table.
+ * 
+ * @param ctx context pointer.
+*/
+static rbuf_res rbuf_sum_reserve(rbuf_ctx *ctx) {
+    rbuf_sum *alloc_slots;
+
+    if (!RBUF_IS_SUMMED(ctx) ||
+        ctx->sum.cap >= ctx->tab.cap) {
+        return RBUF_OK;
+    }
+
+    if ((rbuf_u64)ctx->tab.cap * sizeof(rbuf_sum) > (rbuf_u64)SIZE_MAX) {
+        return RBUF_ERR_NO_MEM;
+    }
+
+    alloc_slots = (rbuf_sum *)rbuf_mem_realloc(ctx, ctx->sum.slots,
+                                               sizeof(rbuf_sum) * ctx->sum.cap,
+                                               sizeof(rbuf_sum) * ctx->tab.cap);
+    if (alloc_slots == NULL) {
+        RBUF_STAT_ADD(ctx, alloc_fail_num, 1);
+
+        return RBUF_ERR_NO_MEM;
+    }
+
+    ctx->sum.slots = alloc_slots;
+    ctx->sum.cap = ctx->tab.cap;
+
+    return RBUF_OK;
+}
+
+/**
+ * @brief forget the CRC-32C of the blocks [from, to),
+ *        they are hashed again when they are needed.
+ * 
+ * @param ctx context pointer.
+ * @param from index of the first block.
+ * @param to index after the last block.
+*/
+static void rbuf_sum_reset(rbuf_ctx *ctx, rbuf_u32 from, rbuf_u32 to) {
+    if (ctx->sum.slots != NULL &&
+        from < to) {
+        memset(rbuf_sum_of(ctx, from), 0, sizeof(rbuf_sum) * (to - from));
+    }
+}
+
+/**
+ * @brief make sure the block index table can hold the specified number of blocks.
+ * 
+ * @param ctx context pointer.
+ * @param block_num the required number of blocks.
+*/
+static rbuf_res rbuf_tab_reserve(rbuf_ctx *ctx, rbuf_u32 block_num) {
+    rbuf_u8 **alloc_blocks;
+    rbuf_u32 head;
+    rbuf_u64 new_cap;
+
+    head = (rbuf_u32)(ctx->tab.blocks - ctx->tab.base);
+    if (block_num <= ctx->tab.cap - head) {
+        return rbuf_sum_reserve(ctx);
+    }
+
+    /* move the live slots down over the ones released from the front. */
+    if (head != 0) {
+        memmove(ctx->tab.base, ctx->tab.blocks, sizeof(rbuf_u8 *) * ctx->cache.block_num);
+        ctx->tab.blocks = ctx->tab.base;
+        if (ctx->sum.slots != NULL) {
+            memmove(ctx->sum.slots, ctx->sum.slots + head, sizeof(rbuf_sum) * ctx->cache.block_num);
+        }
+
+        /* compacting alone is enough when the front took up half of
+           the table, so the cost stays amortized O(1) per block. */
+        if (block_num <= ctx->tab.cap &&
+            head >= ctx->tab.cap / 2) {
+            return rbuf_sum_reserve(ctx);
+        }
+    }
+
+    /* grow the table geometrically, so that growing the
+       buffer block by block costs amortized O(1). */
+    new_cap = (ctx->tab.cap != 0) ? (rbuf_u64)ctx->tab.cap * 2 : RBUF_DEF_TAB_CAP;
+    while (new_cap < block_num) {
+        new_cap *= 2;
+    }
+
+    if (new_cap > UINT32_MAX) {
+        new_cap = UINT32_MAX;
+    }
+
+    if (new_cap * sizeof(rbuf_u8 *) > (rbuf_u64)SIZE_MAX) {
+        return RBUF_ERR_NO_MEM;
+    }
+
+    /* the borrowed table isn't heap memory, so it is copied instead. */
+    if (ctx->tab.borrowed) {
+        alloc_blocks = (rbuf_u8 **)ctx->conf.mem.alloc(ctx->conf.mem.user,
+                                                       sizeof(rbuf_u8 *) * (size_t)new_cap);
+        if (alloc_blocks != NULL) {
+            memcpy(alloc_blocks, ctx->tab.blocks, sizeof(rbuf_u8 *) * ctx->cache.block_num);
+        }
+    } else {
+        alloc_blocks = (rbuf_u8 **)rbuf_mem_realloc(ctx, ctx->tab.base,
+                                                    sizeof(rbuf_u8 *) * ctx->tab.cap,
+                                                    sizeof(rbuf_u8 *) * (size_t)new_cap);
+    }
+
+    if (alloc_blocks == NULL) {
+        RBUF_STAT_ADD(ctx, alloc_fail_num, 1);
+
+        return RBUF_ERR_NO_MEM;
+    }
+
+    ctx->tab.base = alloc_blocks;
+    ctx->tab.blocks = alloc_blocks;
+    ctx->tab.cap = (rbuf_u32)new_cap;
+    ctx->tab.borrowed = false;
+
+    return rbuf_sum_reserve(ctx);
+}
+
+#ifdef RBUF_HAS_MMAP
+
+/**
+ * @brief get the slot of the first block in the mapping.
+ * 
+ * @param ctx context pointer.
+*/
+static rbuf_u32 rbuf_map_first(const rbuf_ctx *ctx) {
+    if (ctx->cache.block_num == 0) {
+        return 0;
+    }
+
+    return (rbuf_u32)((size_t)(ctx->tab.blocks[0] - ctx->map.base) / ctx->conf.block_size);
+}
+
+/**
+ * @brief point the blocks [0, to) of the block index table at their slots.
+ * 
+ * @param ctx context pointer.
+ * @param first slot of the first block.
+ * @param to index after the last block.
+*/
+static void rbuf_map_rebase(rbuf_ctx *ctx, rbuf_u32 first, rbuf_u32 to) {
+    for (rbuf_u32 i = 0; i < to; i++) {
+        ctx->tab.blocks[i] = ctx->map.base + (size_t)ctx->conf.block_size * (first + i);
+    }
+}
+
+/**
+ * @brief extend the mapping to the specified number of slots, the
+ *        file is extended first, so the mapping never runs past it.
+ * 
+ * @param ctx context pointer.
+ * @param slot_num the new number of slots.
+*/
+static rbuf_res rbuf_map_grow(rbuf_ctx *ctx, rbuf_u32 slot_num) {
+    rbuf_u64 new_len;
+    size_t old_len;
+    rbuf_u8 *alloc_base;
+    int prot;
+    int flags;
+
+    new_len = (rbuf_u64)ctx->conf.block_size * slot_num;
+    old_len = (size_t)ctx->conf.block_size * ctx->map.slot_num;
+    if (new_len > (rbuf_u64)SIZE_MAX ||
+        (rbuf_u64)(off_t)new_len != new_len) {
+        return RBUF_ERR_NO_MEM;
+    }
+
+    if (ctx->map.fd >= 0 &&
+        ftruncate(ctx->map.fd, (off_t)new_len) != 0) {
+        RBUF_STAT_ADD(ctx, alloc_fail_num, 1);
+
+        return RBUF_ERR_NO_MEM;
+    }
+
+    prot = PROT_READ | PROT_WRITE;
+    flags = (ctx->map.fd >= 0) ? MAP_SHARED : (MAP_PRIVATE | MAP_ANONYMOUS);
+    if (ctx->map.base == NULL) {
+        alloc_base = (rbuf_u8 *)mmap(NULL, (size_t)new_len, prot, flags, ctx->map.fd, 0);
+    } else {
+#ifdef RBUF_HAS_MREMAP
+        alloc_base = (rbuf_u8 *)mremap(ctx->map.base, old_len, (size_t)new_len, MREMAP_MAYMOVE);
+#else
+
+        /* a shared mapping sees the data through the file,
+           an anonymous one has to be copied over. */
+        alloc_base = (rbuf_u8 *)mmap(NULL, (size_t)new_len, prot, flags, ctx->map.fd, 0);
+        if (alloc_base != (rbuf_u8 *)MAP_FAILED) {
+            if (ctx->map.fd < 0) {
+                memcpy(alloc_base, ctx->map.base, old_len);
+            }
+
+            munmap(ctx->map.base, old_len);
+        }
+#endif
+    }
+
+    /* the file may keep its new length, it only wastes space,
+       the old mapping still covers the same part of it. */
+    if (alloc_base == (rbuf_u8 *)MAP_FAILED) {
+        RBUF_STAT_ADD(ctx, alloc_fail_num, 1);
+
+        return RBUF_ERR_NO_MEM;
+    }
+
+    ctx->map.base = alloc_base;
+    ctx->map.slot_num = slot_num;
+
+    return RBUF_OK;
+}
+
+/**
+ * @brief map the blocks [from, to) of the block index table.
+ * 
+ * @param ctx context pointer.
+ * @param from index of the first block to map.
+ * @param to index after the last block to map.
+*/
+static rbuf_res rbuf_map_alloc(rbuf_ctx *ctx, rbuf_u32 from, rbuf_u32 to) {
+    rbuf_u32 first;
+    rbuf_u64 new_slot_num;
+    rbuf_res res;
+
+    first = rbuf_map_first(ctx);
+    if ((rbuf_u64)first + to <= ctx->map.slot_num) {
+        rbuf_map_rebase(ctx, first, to);
+
+        return RBUF_OK;
+    }
+
+    /* the blocks don't fit after the released front slots, so the
+       live blocks are moved down over them, like the block index table. */
+    if (first != 0) {
+        memmove(ctx->map.base, ctx->tab.blocks[0], (size_t)ctx->conf.block_size * from);
+        first = 0;
+        rbuf_map_rebase(ctx, first, from);
+
+        /* compacting alone is enough when at least half of the
+           mapping is left free, otherwise the mapping grows too. */
+        if (to <= ctx->map.slot_num &&
+            ctx->map.slot_num - to >= ctx->map.slot_num / 2) {
+            rbuf_map_rebase(ctx, first, to);
+
+            return RBUF_OK;
+        }
+    }
+
+    new_slot_num = (ctx->map.slot_num != 0) ? (rbuf_u64)ctx->map.slot_num * 2 : RBUF_DEF_TAB_CAP;
+    while (new_slot_num < to) {
+        new_slot_num *= 2;
+    }
+
+    if (new_slot_num > UINT32_MAX) {
+        new_slot_num = UINT32_MAX;
+    }
+
+    res = rbuf_map_grow(ctx, (rbuf_u32)new_slot_num);
+    if (res != RBUF_OK) {
+        return res;
+    }
+
+    rbuf_map_rebase(ctx, first, to);
+
+    return RBUF_OK;
+}
+
+/**
+ * @brief release the blocks [from, to) of the block index table, the
+ *        pages they fully cover are handed back to the system.
+ * 
+ * @param ctx context pointer.
+ * @param from index of the first block to release.
+ * @param to index after the last block to release.
+*/
+static void rbuf_map_release(rbuf_ctx *ctx, rbuf_u32 from, rbuf_u32 to) {
+    size_t begin;
+    size_t end;
+
+    if (from >= to) {
+        return;
+    }
+
+    begin = (size_t)(ctx->tab.blocks[from] - ctx->map.base);
+    end = begin + (size_t)ctx->conf.block_size * (to - from);
+
+    begin = (begin + ctx->map.page_size - 1) / ctx->map.page_size * ctx->map.page_size;
+    end = end / ctx->map.page_size * ctx->map.page_size;
+    if (begin < end) {
+        madvise(ctx->map.base + begin, end - begin, MADV_DONTNEED);
+    }
+}
+
+/**
+ * @brief set up the mapping, the data of a file which isn't empty
+ *        becomes the initial buffer data.
+ * 
+ * @param ctx context pointer.
+ * @param fd backing file, or 0 or a negative one for anonymous memory.
+*/
+static rbuf_res rbuf_map_init(rbuf_ctx *ctx, int fd) {
+    struct stat st;
+    long page_size;
+
+    page_size = sysconf(_SC_PAGESIZE);
+
+    ctx->map.fd = (fd > 0) ? fd : -1;
+    ctx->map.page_size = (page_size > 0) ? (size_t)page_size : 4096;
+    if (ctx->map.fd < 0 ||
+        RBUF_IS_SPSC(ctx)) {
+        return RBUF_OK;
+    }
+
+    if (fstat(ctx->map.fd, &st) != 0) {
+        return RBUF_ERR;
+    }
+
+    if (st.st_size == 0) {
+        return RBUF_OK;
+    }
+
+    return rbuf_resize64(ctx, (rbuf_u64)st.st_size);
+}
+
+/**
+ * @brief unmap the blocks, a backing file is left holding
+ *        exactly the buffer data, from its beginning.
+ * 
+ * @param ctx context pointer.
+*/
+static rbuf_res rbuf_map_del(rbuf_ctx *ctx) {
+    size_t data_offs;
+    rbuf_res res;
+
+    if (ctx->map.base == NULL) {
+        return RBUF_OK;
+    }
+
+    if (ctx->map.fd >= 0 &&
+        !RBUF_IS_SPSC(ctx)) {
+        data_offs = (size_t)ctx->conf.block_size * rbuf_map_first(ctx) + ctx->cache.head_offs;
+        if (data_offs != 0) {
+            memmove(ctx->map.base, ctx->map.base + data_offs, (size_t)ctx->cache.buff_size);
+        }
+    }
+
+    munmap(ctx->map.base, (size_t)ctx->conf.block_size * ctx->map.slot_num);
+
+    res = RBUF_OK;
+    if (ctx->map.fd >= 0 &&
+        ftruncate(ctx->map.fd, RBUF_IS_SPSC(ctx) ? 0 : (off_t)ctx->cache.buff_size) != 0) {
+        res = RBUF_ERR;
+    }
+
+    ctx->map.base = NULL;
+    ctx->map.slot_num = 0;
+
+    return res;
+}
+
+#else
+
+static rbuf_res rbuf_map_alloc(rbuf_ctx *ctx, rbuf_u32 from, rbuf_u32 to) {
+    (void)ctx;
+    (void)from;
+    (void)to;
+
+    return RBUF_ERR;
+}
+
+static void rbuf_map_release(rbuf_ctx *ctx, rbuf_u32 from, rbuf_u32 to) {
+    (void)ctx;
+    (void)from;
+    (void)to;
+}
+
+static rbuf_res rbuf_map_init(rbuf_ctx *ctx, int fd) {
+    (void)ctx;
+    (void)fd;
+
+    return RBUF_ERR;
+}
+
+static rbuf_res rbuf_map_del(rbuf_ctx *ctx) {
+    (void)ctx;
+
+    return RBUF_OK;
+}
+
+#endif
+
+/**
+ * @brief get the reference count header of a slab chunk in the shared mode.
+ * 
+ * @param chunk chunk pointer.
+*/
+static inline rbuf_share_hdr *rbuf_share_hdr_of(rbuf_u8 *chunk) {
+    return (rbuf_share_hdr *)(void *)(chunk - sizeof(rbuf_share_hdr));
+}
+
+/**
+ * @brief get the slab chunk holding the specified block.
+ * 
+ * @param ctx context pointer.
+ * @param block_idx block index.
+*/
+static inline rbuf_u8 *rbuf_chunk_of(const rbuf_ctx *ctx, rbuf_u32 block_idx) {
+    return ctx->tab.blocks[block_idx] -
+           (size_t)ctx->conf.block_size * ((ctx->tab.phase + block_idx) % ctx->conf.slab_block_num);
+}
+
+/**
+ * @brief get the number of contexts holding a slab chunk in the shared mode.
+ * 
+ * @param chunk chunk pointer.
+*/
+static inline rbuf_u32 rbuf_chunk_refs(rbuf_u8 *chunk) {
+#ifdef RBUF_HAS_ATOMICS
+    return atomic_load(&rbuf_share_hdr_of(chunk)->refs);
+#else
+    return rbuf_share_hdr_of(chunk)->refs;
+#endif
+}
+
+/**
+ * @brief take a reference to a slab chunk in the shared mode.
+ * 
+ * @param chunk chunk pointer.
+*/
+static inline void rbuf_chunk_ref(rbuf_u8 *chunk) {
+#ifdef RBUF_HAS_ATOMICS
+    atomic_fetch_add(&rbuf_share_hdr_of(chunk)->refs, 1);
+#else
+    rbuf_share_hdr_of(chunk)->refs++;
+#endif
+}
+
+/**
+ * @brief drop a reference to a slab chunk in the shared mode.
+ * 
+ * @param chunk chunk pointer.
+ * @return the number of references left.
+*/
+static inline rbuf_u32 rbuf_chunk_unref(rbuf_u8 *chunk) {
+#ifdef RBUF_HAS_ATOMICS
+    return atomic_fetch_sub(&rbuf_share_hdr_of(chunk)->refs, 1) - 1;
+#else
+    return --rbuf_share_hdr_of(chunk)->refs;
+#endif
+}
+
+#ifdef RBUF_HAS_RECYCLE
+
+/* free chunks of one size, linked through their first bytes. */
+typedef struct _rbuf_recycle_list {
+    rbuf_u8 *head;
+    rbuf_u32 num;
+} rbuf_recycle_list;
+
+/* chunk size of each class, a class is taken by the first size put into
+   it and kept for good, so they are read without the lock, 0 is free. */
+static _Atomic size_t rbuf_recycle_sizes[RBUF_RECYCLE_CLASS_NUM];
+
+/* chunks handed over between the threads, guarded by the lock. */
+static rbuf_recycle_list rbuf_recycle_depot[RBUF_RECYCLE_CLASS_NUM];
+static pthread_mutex_t rbuf_recycle_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* chunks of the calling thread, used without any lock, they go
+   to the depot when the thread exits through the key destructor. */
+static _Thread_local rbuf_recycle_list rbuf_recycle_cache[RBUF_RECYCLE_CLASS_NUM];
+static _Thread_local bool rbuf_recycle_joined;
+static pthread_once_t rbuf_recycle_once = PTHREAD_ONCE_INIT;
+static pthread_key_t rbuf_recycle_key;
+
+/**
+ * @brief take the first chunk of a free list.
+ * 
+ * @param list list pointer, it isn't empty.
+*/
+static inline rbuf_u8 *rbuf_recycle_pop(rbuf_recycle_list *list) {
+    rbuf_u8 *chunk;
+
+    chunk = list->head;
+    memcpy(&list->head, chunk, sizeof(rbuf_u8 *));
+    list->num--;
+
+    return chunk;
+}
+
+/**
+ * @brief add a chunk to the front of a free list.
+ * 
+ * @param list list pointer.
+ * @param chunk chunk pointer.
+*/
+static inline void rbuf_recycle_push(rbuf_recycle_list *list, rbuf_u8 *chunk) {
+    memcpy(chunk, &list->head, sizeof(rbuf_u8 *));
+    list->head = chunk;
+    list->num++;
+}
+
+/**
+ * @brief move chunks of the calling thread to the depot, the lock is held,
+ *        the ones beyond the limit of the depot are freed.
+ * 
+ * @param class_idx class index.
+ * @param num number of chunks to move.
+*/
+static void rbuf_recycle_drain(rbuf_u32 class_idx, rbuf_u32 num) {
+    rbuf_recycle_list *cache;
+    rbuf_recycle_list *depot;
+    rbuf_u8 *chunk;
+
+    cache = &rbuf_recycle_cache[class_idx];
+    depot = &rbuf_recycle_depot[class_idx];
+    while (num != 0 &&
+           cache->head != NULL) {
+        chunk = rbuf_recycle_pop(cache);
+        if (depot->num < RBUF_RECYCLE_DEPOT_MAX) {
+            rbuf_recycle_push(depot, chunk);
+        } else {
+            free(chunk);
+        }
+
+        num--;
+    }
+}
+
+/**
+ * @brief hand all the chunks of an exiting thread over to the depot.
+ * 
+ * @param arg unused.
+*/
+static void rbuf_recycle_exit(void *arg) {
+    (void)arg;
+
+    pthread_mutex_lock(&rbuf_recycle_lock);
+    for (rbuf_u32 i = 0; i < RBUF_RECYCLE_CLASS_NUM; i++) {
+        rbuf_recycle_drain(i, UINT32_MAX);
+    }
+    pthread_mutex_unlock(&rbuf_recycle_lock);
+}
+
+/**
+ * @brief create the key whose destructor runs when a thread exits.
+*/
+static void rbuf_recycle_key_init(void) {
+    pthread_key_create(&rbuf_recycle_key, rbuf_recycle_exit);
+}
+
+/**
+ * @brief register the calling thread for the key destructor, once, so the
+ *        chunks it keeps go to the depot when it exits.
+*/
+static void rbuf_recycle_join(void) {
+    if (!rbuf_recycle_joined) {
+        pthread_once(&rbuf_recycle_once, rbuf_recycle_key_init);
+        pthread_setspecific(rbuf_recycle_key, &rbuf_recycle_joined);
+        rbuf_recycle_joined = true;
+    }
+}
+
+/**
+ * @brief find the class of a chunk size.
+ * 
+ * @param size chunk size.
+ * @param add whether a free class is taken for a new size.
+ * @return the class index, or -1 when there is none.
+*/
+static int rbuf_recycle_class(size_t size, bool add) {
+    size_t class_size;
+
+    for (int i = 0; i < RBUF_RECYCLE_CLASS_NUM; i++) {
+        class_size = atomic_load_explicit(&rbuf_recycle_sizes[i], memory_order_acquire);
+        if (class_size == 0) {
+            if (!add) {
+                return -1;
+            }
+
+            /* another thread may take the class meanwhile. */
+            pthread_mutex_lock(&rbuf_recycle_lock);
+            class_size = atomic_load_explicit(&rbuf_recycle_sizes[i], memory_order_relaxed);
+            if (class_size == 0) {
+                class_size = size;
+                atomic_store_explicit(&rbuf_recycle_sizes[i], size, memory_order_release);
+            }
+            pthread_mutex_unlock(&rbuf_recycle_lock);
+        }
+
+        if (class_size == size) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * @brief get a chunk from the recycler, the calling thread's own chunks go
+ *        first, then a batch is fetched from the depot.
+ * 
+ * @param size chunk size.
+ * @return the chunk, or NULL when there is none of the size.
+*/
+static rbuf_u8 *rbuf_recycle_get(size_t size) {
+    rbuf_recycle_list *cache;
+    rbuf_recycle_list *depot;
+    int class_idx;
+
+    class_idx = rbuf_recycle_class(size, false);
+    if (class_idx < 0) {
+        return NULL;
+    }
+
+    cache = &rbuf_recycle_cache[class_idx];
+    if (cache->head == NULL) {
+        depot = &rbuf_recycle_depot[class_idx];
+
+        /* the batch stays with the thread, which may only allocate. */
+        rbuf_recycle_join();
+
+        pthread_mutex_lock(&rbuf_recycle_lock);
+        while (depot->head != NULL &&
+               cache->num < RBUF_RECYCLE_BATCH) {
+            rbuf_recycle_push(cache, rbuf_recycle_pop(depot));
+        }
+        pthread_mutex_unlock(&rbuf_recycle_lock);
+
+        if (cache->head == NULL) {
+            return NULL;
+        }
+    }
+
+    return rbuf_recycle_pop(cache);
+}
+
+/**
+ * @brief put a chunk into the recycler, it is kept by the calling thread,
+ *        a batch goes to the depot once the thread keeps too many.
+ * 
+ * @param chunk chunk pointer, it was allocated by malloc().
+ * @param size chunk size.
+ * @return whether the chunk was taken.
+*/
+static bool rbuf_recycle_put(rbuf_u8 *chunk, size_t size) {
+    rbuf_recycle_list *cache;
+    int class_idx;
+
+    class_idx = rbuf_recycle_class(size, true);
+    if (class_idx < 0) {
+        return false;
+    }
+
+    rbuf_recycle_join();
+
+    cache = &rbuf_recycle_cache[class_idx];
+    rbuf_recycle_push(cache, chunk);
+    if (cache->num > RBUF_RECYCLE_THREAD_MAX) {
+        pthread_mutex_lock(&rbuf_recycle_lock);
+        rbuf_recycle_drain((rbuf_u32)class_idx, RBUF_RECYCLE_BATCH);
+        pthread_mutex_unlock(&rbuf_recycle_lock);
+    }
+
+    return true;
+}
+
+/**
+ * @brief free the chunks kept by the calling thread and the depot.
+*/
+rbuf_res rbuf_recycle_trim(void) {
+    pthread_mutex_lock(&rbuf_recycle_lock);
+    for (rbuf_u32 i = 0; i < RBUF_RECYCLE_CLASS_NUM; i++) {
+        while (rbuf_recycle_cache[i].head != NULL) {
+            free(rbuf_recycle_pop(&rbuf_recycle_cache[i]));
+        }
+
+        while (rbuf_recycle_depot[i].head != NULL) {
+            free(rbuf_recycle_pop(&rbuf_recycle_depot[i]));
+        }
+    }
+    pthread_mutex_unlock(&rbuf_recycle_lock);
+
+    return RBUF_OK;
+}
+
+#else
+
+static rbuf_u8 *rbuf_recycle_get(size_t size) {
+    (void)size;
+
+    return NULL;
+}
+
+static bool rbuf_recycle_put(rbuf_u8 *chunk, size_t size) {
+    (void)chunk;
+    (void)size;
+
+    return false;
+}
+
+rbuf_res rbuf_recycle_trim(void) {
+    return RBUF_OK;
+}
+
+#endif
+
+/**
+ * @brief free the memory of a slab chunk, along with its header.
+ * 
+ * @param ctx context pointer.
+ * @param chunk chunk pointer.
+*/
+static void rbuf_chunk_free(rbuf_ctx *ctx, rbuf_u8 *chunk) {
+    if (RBUF_IS_RECYCLED(ctx) &&
+        rbuf_recycle_put(chunk, (size_t)ctx->conf.block_size * ctx->conf.slab_block_num)) {
+        return;
+    }
+
+    rbuf_mem_free_chunk(ctx, chunk, (size_t)ctx->conf.block_size * ctx->conf.slab_block_num,
+                        RBUF_IS_SHARED(ctx) ? sizeof(rbuf_share_hdr) : 0);
+}
+
+/**
+ * @brief get a slab chunk, a block of the pool, a spare
+ *        one or a recycled one is reused first.
+ * 
+ * @param ctx context pointer.
+*/
+static rbuf_u8 *rbuf_chunk_get(rbuf_ctx *ctx) {
+    rbuf_u8 *chunk;
+
+    if (ctx->pool.free != NULL) {
+        chunk = ctx->pool.free;
+        memcpy(&ctx->pool.free, chunk, sizeof(rbuf_u8 *));
+
+        return chunk;
+    }
+
+    if (ctx->spare.num != 0) {
+        ctx->spare.num--;
+        chunk = ctx->spare.chunks[ctx->spare.num];
+    } else if (RBUF_IS_SHARED(ctx)) {
+        chunk = rbuf_mem_alloc_chunk(ctx, (size_t)ctx->conf.block_size * ctx->conf.slab_block_num,
+                                     sizeof(rbuf_share_hdr));
+        if (chunk == NULL) {
+            return NULL;
+        }
+    } else {
+        if (RBUF_IS_RECYCLED(ctx)) {
+            chunk = rbuf_recycle_get((size_t)ctx->conf.block_size * ctx->conf.slab_block_num);
+            if (chunk != NULL) {
+                return chunk;
+            }
+        }
+
+        return rbuf_mem_alloc_chunk(ctx, (size_t)ctx->conf.block_size * ctx->conf.slab_block_num, 0);
+    }
+
+    if (RBUF_IS_SHARED(ctx)) {
+#ifdef RBUF_HAS_ATOMICS
+        atomic_init(&rbuf_share_hdr_of(chunk)->refs, 1);
+#else
+        rbuf_share_hdr_of(chunk)->refs = 1;
+#endif
+    }
+
+    return chunk;
+}
+
+/**
+ * @brief put back a slab chunk, to the pool, the spare chunks or the allocator.
+ * 
+ * @param ctx context pointer.
+ * @param chunk chunk pointer.
+*/
+static void rbuf_chunk_put(rbuf_ctx *ctx, rbuf_u8 *chunk) {
+    if ((uintptr_t)chunk >= (uintptr_t)ctx->pool.base &&
+        (uintptr_t)chunk < (uintptr_t)ctx->pool.end) {
+        memcpy(chunk, &ctx->pool.free, sizeof(rbuf_u8 *));
+        ctx->pool.free = chunk;
+
+        return;
+    }
+
+    if (RBUF_IS_SHARED(ctx) &&
+        rbuf_chunk_unref(chunk) != 0) {
+        return;
+    }
+
+    if (ctx->conf.spare_high == 0) {
+        rbuf_chunk_free(ctx, chunk);
+
+        return;
+    }
+
+    /* drop down to the low watermark in one go, so a buffer oscillating
+       around the high watermark doesn't free a chunk on every shrink. */
+    if (ctx->spare.num == ctx->conf.spare_high) {
+        while (ctx->spare.num > ctx->conf.spare_low) {
+            ctx->spare.num--;
+            rbuf_chunk_free(ctx, ctx->spare.chunks[ctx->spare.num]);
+        }
+
+        if (ctx->spare.num == ctx->conf.spare_high) {
+            rbuf_chunk_free(ctx, chunk);
+
+            return;
+        }
+    }
+
+    ctx->spare.chunks[ctx->spare.num] = chunk;
+    ctx->spare.num++;
+}
+
+/**
+ * @brief release the blocks [from, to) of the block index table,
+ *        a slab chunk is freed along with its last live block.
+ * 
+ * @param ctx context pointer.
+ * @param from index of the first block to release.
+ * @param to index after the last block to release.
+*/
+static void rbuf_chunk_release(rbuf_ctx *ctx, rbuf_u32 from, rbuf_u32 to) {
+    rbuf_u32 slab_block_num;
+    rbuf_u32 chunk_offs;
+
+#if RBUF_INLINE_SIZE > 0
+
+    /* the inline block is the whole buffer, so it goes all at once. */
+    if (RBUF_IS_INLINE(ctx)) {
+        if (from == 0 &&
+            to != 0) {
+            ctx->cache.inline_used = false;
+        }
+
+        return;
+    }
+#endif
+
+    RBUF_STAT_ADD(ctx, block_free_num, to - from);
+
+    if (RBUF_IS_MMAP(ctx)) {
+        rbuf_map_release(ctx, from, to);
+
+        return;
+    }
+
+    slab_block_num = ctx->conf.slab_block_num;
+    for (rbuf_u32 i = from; i < to; i++) {
+        chunk_offs = (ctx->tab.phase + i) % slab_block_num;
+
+        /* the chunk still has live blocks after this one. */
+        if (i + 1 != ctx->cache.block_num &&
+            (chunk_offs + 1) % slab_block_num != 0) {
+            continue;
+        }
+
+        /* the chunk still has live blocks before "from". */
+        if (from != 0 &&
+            chunk_offs > i - from) {
+            continue;
+        }
+
+        /* the blocks of the adaptive mode differ in size, and are neither
+           spare, pooled nor shared. */
+        if (RBUF_IS_ADAPTIVE(ctx)) {
+            rbuf_mem_free_chunk(ctx, ctx->tab.blocks[i], rbuf_block_size(ctx, i), 0);
+            continue;
+        }
+
+        rbuf_chunk_put(ctx, ctx->tab.blocks[i] - (size_t)ctx->conf.block_size * chunk_offs);
+    }
+}
+
+/**
+ * @brief copy the slab chunk holding the specified block when it is shared.
+ * 
+ * @param ctx context pointer.
+ * @param block_idx block index.
+*/
+static rbuf_res rbuf_chunk_unshare(rbuf_ctx *ctx, rbuf_u32 block_idx) {
+    rbuf_u32 slab_block_num;
+    rbuf_u32 chunk_offs;
+    rbuf_u32 from;
+    rbuf_u32 to;
+    rbuf_u8 *old_chunk;
+    rbuf_u8 *chunk;
+
+    old_chunk = rbuf_chunk_of(ctx, block_idx);
+    if (rbuf_chunk_refs(old_chunk) == 1) {
+        return RBUF_OK;
+    }
+
+    chunk = rbuf_chunk_get(ctx);
+    if (chunk == NULL) {
+        RBUF_STAT_ADD(ctx, alloc_fail_num, 1);
+
+        return RBUF_ERR_NO_MEM;
+    }
+
+    slab_block_num = ctx->conf.slab_block_num;
+    chunk_offs = (ctx->tab.phase + block_idx) % slab_block_num;
+    from = (chunk_offs <= block_idx) ? block_idx - chunk_offs : 0;
+    to = block_idx + (slab_block_num - chunk_offs);
+    if (to > ctx->cache.block_num) {
+        to = ctx->cache.block_num;
+    }
+
+    for (rbuf_u32 i = from; i < to; i++) {
+        chunk_offs = (ctx->tab.phase + i) % slab_block_num;
+        memcpy(chunk + (size_t)ctx->conf.block_size * chunk_offs,
+               ctx->tab.blocks[i], ctx->conf.block_size);
+        ctx->tab.blocks[i] = chunk + (size_t)ctx->conf.block_size * chunk_offs;
+        rbuf_align_note(ctx, ctx->tab.blocks[i]);
+    }
+
+    /* the other contexts may have let go of it meanwhile. */
+    rbuf_chunk_put(ctx, old_chunk);
+
+    RBUF_STAT_ADD(ctx, block_alloc_num, to - from);
+    RBUF_STAT_ADD(ctx, block_free_num, to - from);
+
+    return RBUF_OK;
+}
+
+/**
+ * @brief allocate the blocks [from, to) of the block index table,
+ *        one slab chunk at a time.
+ * 
+ * @param ctx context pointer.
+ * @param from index of the first block to allocate.
+ * @param to index after the last block to allocate.
+*/
+static rbuf_res rbuf_chunk_alloc(rbuf_ctx *ctx, rbuf_u32 from, rbuf_u32 to) {
+    rbuf_u32 slab_block_num;
+    rbuf_u8 *chunk;
+
+    /* the slots may still hold the CRC-32C of the blocks released there. */
+    rbuf_sum_reset(ctx, from, to);
+
+    if (RBUF_IS_MMAP(ctx)) {
+        if (rbuf_map_alloc(ctx, from, to) != RBUF_OK) {
+            return RBUF_ERR_NO_MEM;
+        }
+
+        for (rbuf_u32 i = from; i < to; i++) {
+            rbuf_align_note(ctx, ctx->tab.blocks[i]);
+        }
+
+        RBUF_STAT_ADD(ctx, block_alloc_num, to - from);
+
+        return RBUF_OK;
+    }
+
+    slab_block_num = ctx->conf.slab_block_num;
+    if ((rbuf_u64)ctx->conf.block_size * slab_block_num > (rbuf_u64)SIZE_MAX - sizeof(rbuf_share_hdr)) {
+        return RBUF_ERR_NO_MEM;
+    }
+
+    /* the rest of a shared chunk belongs to each context holding it. */
+    if (ctx->cache.shared &&
+        from != 0 &&
+        (ctx->tab.phase + from) % slab_block_num != 0) {
+        if (rbuf_chunk_unshare(ctx, from - 1) != RBUF_OK) {
+            return RBUF_ERR_NO_MEM;
+        }
+    }
+
+    for (rbuf_u32 i = from; i < to; i++) {
+        if ((ctx->tab.phase + i) % slab_block_num != 0) {
+
+            /* the chunk was allocated along with the previous block. */
+            ctx->tab.blocks[i] = ctx->tab.blocks[i - 1] + ctx->conf.block_size;
+            continue;
+        }
+
+        if (RBUF_IS_ADAPTIVE(ctx)) {
+            chunk = rbuf_mem_alloc_chunk(ctx, rbuf_block_size(ctx, i), 0);
+        } else {
+            chunk = rbuf_chunk_get(ctx);
+        }
+
+        if (chunk == NULL) {
+            RBUF_STAT_ADD(ctx, alloc_fail_num, 1);
+
+            /* roll back, so the buffer stays as it was. */
+            RBUF_STAT_ADD(ctx, block_alloc_num, i - from);
+            rbuf_chunk_release(ctx, from, i);
+
+            return RBUF_ERR_NO_MEM;
+        }
+
+        ctx->tab.blocks[i] = chunk;
+    }
+
+    for (rbuf_u32 i = from; i < to; i++) {
+        rbuf_align_note(ctx, ctx->tab.blocks[i]);
+    }
+
+    RBUF_STAT_ADD(ctx, block_alloc_num, to - from);
+
+    return RBUF_OK;
+}
+
+/**
+ * @brief describe a range of the blocks with scatter/gather elements,
+ *        the range may run past the buffer size, but not past the blocks.
+ * 
+ * @param ctx context pointer.
+ * @param offs offset indicating where the range starts in the resizable buffer.
+ * @param size size of the range.
+ * @param iov scatter/gather array to fill.
+ * @param iovcnt the address of the element number, it holds the capacity of
+ *               the array on entry and the number of filled elements on return.
+*/
+static void rbuf_iov_fill(rbuf_ctx *ctx, rbuf_u64 offs, rbuf_u64 size, rbuf_iovec *iov, int *iovcnt) {
+    rbuf_u32 block_idx;
+    rbuf_u32 block_offs;
+    rbuf_u64 rest_size;
+    rbuf_u32 curt_size;
+    int iov_idx;
+
+    block_idx = (rbuf_u32)rbuf_block_idx(ctx, offs);
+    block_offs = rbuf_block_offs(ctx, offs);
+    rest_size = size;
+    iov_idx = 0;
+    while (rest_size != 0 &&
+           iov_idx < *iovcnt) {
+        curt_size = rbuf_block_size(ctx, block_idx) - block_offs;
+        if (curt_size > rest_size) {
+            curt_size = (rbuf_u32)rest_size;
+        }
+
+        iov[iov_idx].iov_base = ctx->tab.blocks[block_idx] + block_offs;
+        iov[iov_idx].iov_len = curt_size;
+
+        rest_size -= curt_size;
+        iov_idx++;
+        block_idx++;
+        block_offs = 0;
+    }
+
+    *iovcnt = iov_idx;
+}
+
+/**
+ * @brief forget the released blocks once the buffer holds no block,
+ *        so the next block starts a fresh slab chunk.
+ * 
+ * @param ctx context pointer.
+*/
+static void rbuf_head_reset(rbuf_ctx *ctx) {
+    ctx->tab.blocks = ctx->tab.base;
+    ctx->cache.shared = false;
+    ctx->tab.phase = 0;
+    ctx->tab.first_no = 0;
+    ctx->tab.first_pos = 0;
+    ctx->cache.head_offs = 0;
+    ctx->cache.block_align = 0;
+}
+
+/**
+ * @brief drop the contiguous copy when it overlaps the specified range,
+ *        the range is about to change.
+ * 
+ * @param ctx context pointer.
+ * @param offs offset of the range.
+ * @param size size of the range.
+*/
+static inline void rbuf_lin_drop(rbuf_ctx *ctx, rbuf_u64 offs, rbuf_u64 size) {
+    if (ctx->lin.size != 0 &&
+        offs < ctx->lin.offs + ctx->lin.size &&
+        ctx->lin.offs < offs + size) {
+        ctx->lin.size = 0;
+    }
+}
+
+/* CRC-32C (Castagnoli) of each byte value, reflected polynomial 0x82f63b78. */
+static const rbuf_u32 rbuf_crc32c_tab[256] = {
+    0x00000000U, 0xf26b8303U, 0xe13b70f7U, 0x1350f3f4U, 0xc79a971fU, 0x35f1141cU,
+    0x26a1e7e8U, 0xd4ca64ebU, 0x8ad958cfU, 0x78b2dbccU, 0x6be22838U, 0x9989ab3bU,
+    0x4d43cfd0U, 0xbf284cd3U, 0xac78bf27U, 0x5e133c24U, 0x105ec76fU, 0xe235446cU,
+    0xf165b798U, 0x030e349bU, 0xd7c45070U, 0x25afd373U, 0x36ff2087U, 0xc494a384U,
+    0x9a879fa0U, 0x68ec1ca3U, 0x7bbcef57U, 0x89d76c54U, 0x5d1d08bfU, 0xaf768bbcU,
+    0xbc267848U, 0x4e4dfb4bU, 0x20bd8edeU, 0xd2d60dddU, 0xc186fe29U, 0x33ed7d2aU,
+    0xe72719c1U, 0x154c9ac2U, 0x061c6936U, 0xf477ea35U, 0xaa64d611U, 0x580f5512U,
+    0x4b5fa6e6U, 0xb93425e5U, 0x6dfe410eU, 0x9f95c20dU, 0x8cc531f9U, 0x7eaeb2faU,
+    0x30e349b1U, 0xc288cab2U, 0xd1d83946U, 0x23b3ba45U, 0xf779deaeU, 0x05125dadU,
+    0x1642ae59U, 0xe4292d5aU, 0xba3a117eU, 0x4851927dU, 0x5b016189U, 0xa96ae28aU,
+    0x7da08661U, 0x8fcb0562U, 0x9c9bf696U, 0x6ef07595U, 0x417b1dbcU, 0xb3109ebfU,
+    0xa0406d4bU, 0x522bee48U, 0x86e18aa3U, 0x748a09a0U, 0x67dafa54U, 0x95b17957U,
+    0xcba24573U, 0x39c9c670U, 0x2a993584U, 0xd8f2b687U, 0x0c38d26cU, 0xfe53516fU,
+    0xed03a29bU, 0x1f682198U, 0x5125dad3U, 0xa34e59d0U, 0xb01eaa24U, 0x42752927U,
+    0x96bf4dccU, 0x64d4cecfU, 0x77843d3bU, 0x85efbe38U, 0xdbfc821cU, 0x2997011fU,
+    0x3ac7f2ebU, 0xc8ac71e8U, 0x1c661503U, 0xee0d9600U, 0xfd5d65f4U, 0x0f36e6f7U,
+    0x61c69362U, 0x93ad1061U, 0x80fde395U, 0x72966096U, 0xa65c047dU, 0x5437877eU,
+    0x4767748aU, 0xb50cf789U, 0xeb1fcbadU, 0x197448aeU, 0x0a24bb5aU, 0xf84f3859U,
+    0x2c855cb2U, 0xdeeedfb1U, 0xcdbe2c45U, 0x3fd5af46U, 0x7198540dU, 0x83f3d70eU,
+    0x90a324faU, 0x62c8a7f9U, 0xb602c312U, 0x44694011U, 0x5739b3e5U, 0xa55230e6U,
+    0xfb410cc2U, 0x092a8fc1U, 0x1a7a7c35U, 0xe811ff36U, 0x3cdb9bddU, 0xceb018deU,
+    0xdde0eb2aU, 0x2f8b6829U, 0x82f63b78U, 0x709db87bU, 0x63cd4b8fU, 0x91a6c88cU,
+    0x456cac67U, 0xb7072f64U, 0xa457dc90U, 0x563c5f93U, 0x082f63b7U, 0xfa44e0b4U,
+    0xe9141340U, 0x1b7f9043U, 0xcfb5f4a8U, 0x3dde77abU, 0x2e8e845fU, 0xdce5075cU,
+    0x92a8fc17U, 0x60c37f14U, 0x73938ce0U, 0x81f80fe3U, 0x55326b08U, 0xa759e80bU,
+    0xb4091bffU, 0x466298fcU, 0x1871a4d8U, 0xea1a27dbU, 0xf94ad42fU, 0x0b21572cU,
+    0xdfeb33c7U, 0x2d80b0c4U, 0x3ed04330U, 0xccbbc033U, 0xa24bb5a6U, 0x502036a5U,
+    0x4370c551U, 0xb11b4652U, 0x65d122b9U, 0x97baa1baU, 0x84ea524eU, 0x7681d14dU,
+    0x2892ed69U, 0xdaf96e6aU, 0xc9a99d9eU, 0x3bc21e9dU, 0xef087a76U, 0x1d63f975U,
+    0x0e330a81U, 0xfc588982U, 0xb21572c9U, 0x407ef1caU, 0x532e023eU, 0xa145813dU,
+    0x758fe5d6U, 0x87e466d5U, 0x94b49521U, 0x66df1622U, 0x38cc2a06U, 0xcaa7a905U,
+    0xd9f75af1U, 0x2b9cd9f2U, 0xff56bd19U, 0x0d3d3e1aU, 0x1e6dcdeeU, 0xec064eedU,
+    0xc38d26c4U, 0x31e6a5c7U, 0x22b65633U, 0xd0ddd530U, 0x0417b1dbU, 0xf67c32d8U,
+    0xe52cc12cU, 0x1747422fU, 0x49547e0bU, 0xbb3ffd08U, 0xa86f0efcU, 0x5a048dffU,
+    0x8ecee914U, 0x7ca56a17U, 0x6ff599e3U, 0x9d9e1ae0U, 0xd3d3e1abU, 0x21b862a8U,
+    0x32e8915cU, 0xc083125fU, 0x144976b4U, 0xe622f5b7U, 0xf5720643U, 0x07198540U,
+    0x590ab964U, 0xab613a67U, 0xb831c993U, 0x4a5a4a90U, 0x9e902e7bU, 0x6cfbad78U,
+    0x7fab5e8cU, 0x8dc0dd8fU, 0xe330a81aU, 0x115b2b19U, 0x020bd8edU, 0xf0605beeU,
+    0x24aa3f05U, 0xd6c1bc06U, 0xc5914ff2U, 0x37faccf1U, 0x69e9f0d5U, 0x9b8273d6U,
+    0x88d28022U, 0x7ab90321U, 0xae7367caU, 0x5c18e4c9U, 0x4f48173dU, 0xbd23943eU,
+    0xf36e6f75U, 0x0105ec76U, 0x12551f82U, 0xe03e9c81U, 0x34f4f86aU, 0xc69f7b69U,
+    0xd5cf889dU, 0x27a40b9eU, 0x79b737baU, 0x8bdcb4b9U, 0x988c474dU, 0x6ae7c44eU,
+    0xbe2da0a5U, 0x4c4623a6U, 0x5f16d052U, 0xad7d5351U
+};
+
+#ifdef RBUF_HAS_CRC32C_SSE42
+
+/**
+ * @brief continue the inverted CRC-32C with the SSE 4.2 instructions.
+ * 
+ * @param crc inverted CRC-32C so far.
+ * @param data data pointer.
+ * @param size data size.
+*/
+__attribute__((target("sse4.2")))
+static rbuf_u32 rbuf_crc32c_sse42(rbuf_u32 crc, const rbuf_u8 *data, size_t size) {
+#ifdef __x86_64__
+    rbuf_u64 crc64;
+    rbuf_u64 word;
+
+    crc64 = crc;
+    for (; size >= 8; size -= 8) {
+        memcpy(&word, data, 8);
+        crc64 = __builtin_ia32_crc32di(crc64, word);
+        data += 8;
+    }
+
+    crc = (rbuf_u32)crc64;
+#endif
+    for (; size != 0; size--) {
+        crc = __builtin_ia32_crc32qi(crc, *data);
+        data++;
+    }
+
+    return crc;
+}
+
+#endif
+
+/**
+ * @brief continue the CRC-32C of some data with more data, with the CRC-32C
+ *        instructions of the processor when it has them.
+ * 
+ * @param crc CRC-32C of the data so far, 0 for none.
+ * @param data data pointer.
+ * @param size data size.
+*/
+static rbuf_u32 rbuf_crc32c_update(rbuf_u32 crc, const rbuf_u8 *data, size_t size) {
+    crc = ~crc;
+
+#if defined(RBUF_HAS_CRC32C_SSE42)
+    if (__builtin_cpu_supports("sse4.2")) {
+        return ~rbuf_crc32c_sse42(crc, data, size);
+    }
+#elif defined(RBUF_HAS_CRC32C_ARM)
+    rbuf_u64 word;
+
+    for (; size >= 8; size -= 8) {
+        memcpy(&word, data, 8);
+        crc = __crc32cd(crc, word);
+        data += 8;
+    }
+#endif
+
+    for (; size != 0; size--) {
+        crc = rbuf_crc32c_tab[(crc ^ *data) & 0xff] ^ (crc >> 8);
+        data++;
+    }
+
+    return ~crc;
+}
+
+/**
+ * @brief continue the CRC-32C of some data with a range of the resizable buffer.
+ * 
+ * @param ctx context pointer.
+ * @param crc CRC-32C of the data so far, 0 for none.
+ * @param offs offset indicating where the range starts in the resizable buffer.
+ * @param size size of the range.
+*/
+static rbuf_u32 rbuf_range_crc32c(rbuf_ctx *ctx, rbuf_u32 crc, rbuf_u64 offs, rbuf_u64 size) {
+    rbuf_u32 block_idx;
+    rbuf_u32 block_offs;
+    rbuf_u32 curt_size;
+
+    if (size == 0) {
+        return crc;
+    }
+
+    block_idx = (rbuf_u32)rbuf_block_idx(ctx, offs);
+    block_offs = rbuf_block_offs(ctx, offs);
+    while (size != 0) {
+        curt_size = rbuf_block_size(ctx, block_idx) - block_offs;
+        if (curt_size > size) {
+            curt_size = (rbuf_u32)size;
+        }
+
+        crc = rbuf_crc32c_update(crc, ctx->tab.blocks[block_idx] + block_offs, curt_size);
+
+        size -= curt_size;
+        block_idx++;
+        block_offs = 0;
+    }
+
+    return crc;
+}
+
+/**
+ * @brief multiply two polynomials modulo the CRC-32C polynomial, in the
+ *        reflected bit order of the CRC.
+ * 
+ * @param a the first polynomial.
+ * @param b the second polynomial.
+*/
+static rbuf_u32 rbuf_crc32c_mul(rbuf_u32 a, rbuf_u32 b) {
+    rbuf_u32 prod;
+
+    /* the highest bit stands for x^0. */
+    prod = 0;
+    for (rbuf_u32 mask = (rbuf_u32)1 << 31; mask != 0; mask >>= 1) {
+        if ((a & mask) != 0) {
+            prod ^= b;
+        }
+
+        b = ((b & 1) != 0) ? (b >> 1) ^ 0x82f63b78U : b >> 1;
+    }
+
+    return prod;
+}
+
+/* x^(8 * 2^i) modulo the CRC-32C polynomial, in the reflected bit
+   order, the shift of a CRC-32C over 2^i bytes. */
+static const rbuf_u32 rbuf_crc32c_pow_tab[32] = {
+    0x00800000U, 0x00008000U, 0x82f63b78U, 0x6ea2d55cU, 0x18b8ea18U, 0x510ac59aU,
+    0xb82be955U, 0xb8fdb1e7U, 0x88e56f72U, 0x74c360a4U, 0xe4172b16U, 0x0d65762aU,
+    0x35d73a62U, 0x28461564U, 0xbf455269U, 0xe2ea32dcU, 0xfe7740e6U, 0xf946610bU,
+    0x3c204f8fU, 0x538586e3U, 0x59726915U, 0x734d5309U, 0xbc1ac763U, 0x7d0722ccU,
+    0xd289cabeU, 0xe94ca9bcU, 0x05b74f3fU, 0xa51e1f42U, 0x40000000U, 0x20000000U,
+    0x08000000U, 0x00800000U
+};
+
+/**
+ * @brief get the polynomial shifting a CRC-32C over the specified number of
+ *        bytes, for combining the CRC-32C of the blocks.
+ * 
+ * @param size number of bytes, it isn't 0.
+*/
+static rbuf_u32 rbuf_crc32c_shift(rbuf_u32 size) {
+    rbuf_u32 shift;
+
+    /* a power of x is never 0, so 0 means none is taken yet, and
+       a power of two, the block size mostly, takes no multiplication. */
+    shift = 0;
+    for (rbuf_u32 i = 0; size != 0; i++) {
+        if ((size & 1) != 0) {
+            shift = (shift == 0) ? rbuf_crc32c_pow_tab[i] :
+                                   rbuf_crc32c_mul(rbuf_crc32c_pow_tab[i], shift);
+        }
+
+        size >>= 1;
+    }
+
+    return shift;
+}
+
+/**
+ * @brief forget the CRC-32C of the blocks holding a range when it covers
+ *        bytes of the range, the range is about to change.
+ * 
+ * @param ctx context pointer.
+ * @param offs offset of the range.
+ * @param size size of the range.
+*/
+static void rbuf_sum_drop(rbuf_ctx *ctx, rbuf_u64 offs, rbuf_u64 size) {
+    rbuf_u64 first;
+    rbuf_u64 last;
+    rbuf_sum *sum;
+
+    if (ctx->sum.slots == NULL ||
+        size == 0) {
+        return;
+    }
+
+    first = rbuf_block_idx(ctx, offs);
+    if (first >= ctx->cache.block_num) {
+        return;
+    }
+
+    last = rbuf_block_idx(ctx, offs + size - 1);
+    if (last >= ctx->cache.block_num) {
+        last = (rbuf_u64)ctx->cache.block_num - 1;
+    }
+
+    sum = rbuf_sum_of(ctx, (rbuf_u32)first);
+    if (rbuf_block_offs(ctx, offs) < sum->to) {
+        memset(sum, 0, sizeof(rbuf_sum));
+    }
+
+    /* the range covers the following blocks from their start. */
+    rbuf_sum_reset(ctx, (rbuf_u32)first + 1, (rbuf_u32)last + 1);
+}
+
+/**
+ * @brief continue the CRC-32C of a block with the bytes just written into it.
+ * 
+ * @param ctx context pointer.
+ * @param block_idx block index.
+ * @param block_offs offset of the bytes in the block.
+ * @param size number of bytes, they lie inside the block.
+*/
+static inline void rbuf_sum_add(rbuf_ctx *ctx, rbuf_u32 block_idx, rbuf_u32 block_offs, rbuf_u32 size) {
+    rbuf_sum *sum;
+
+    sum = rbuf_sum_of(ctx, block_idx);
+    if (sum->from == sum->to) {
+        if (block_offs != ((block_idx == 0) ? ctx->cache.head_offs : 0)) {
+            return;
+        }
+
+        sum->crc = 0;
+        sum->from = block_offs;
+        sum->to = block_offs;
+    }
+
+    if (sum->to == block_offs) {
+        sum->crc = rbuf_crc32c_update(sum->crc, ctx->tab.blocks[block_idx] + block_offs, size);
+        sum->to += size;
+    }
+}
+
+/**
+ * @brief continue the CRC-32C of the blocks with a range just written,
+ *        block by block.
+ * 
+ * @param ctx context pointer.
+ * @param offs offset of the range.
+ * @param size size of the range, it lies inside the blocks.
+*/
+static void rbuf_sum_add_range(rbuf_ctx *ctx, rbuf_u64 offs, rbuf_u64 size) {
+    rbuf_u32 block_idx;
+    rbuf_u32 block_offs;
+    rbuf_u32 curt_size;
+
+    if (!RBUF_IS_SUMMED(ctx) ||
+        size == 0) {
+        return;
+    }
+
+    block_idx = (rbuf_u32)rbuf_block_idx(ctx, offs);
+    block_offs = rbuf_block_offs(ctx, offs);
+    while (size != 0) {
+        curt_size = rbuf_block_size(ctx, block_idx) - block_offs;
+        if (curt_size > size) {
+            curt_size = (rbuf_u32)size;
+        }
+
+        rbuf_sum_add(ctx, block_idx, block_offs, curt_size);
+
+        size -= curt_size;
+        block_idx++;
+        block_offs = 0;
+    }
+}
+
+/**
+ * @brief get the number of blocks needed to hold the specified size,
+ *        the consumed part of the first block is taken into account.
+ * 
+ * @param ctx context pointer.
+ * @param size buffer size, it is at most RBUF_SIZE_LIMIT.
+*/
+static inline rbuf_u64 rbuf_block_num(const rbuf_ctx *ctx, rbuf_u64 size) {
+    if (size == 0) {
+        return 0;
+    }
+
+    return rbuf_block_idx(ctx, size) +
+           ((rbuf_block_offs(ctx, size) != 0) ? 1 : 0);
+}
+
+/**
+ * @brief update the cached append position from the buffer size.
+ * 
+ * @param ctx context pointer.
+*/
+static void rbuf_tail_update(rbuf_ctx *ctx) {
+    rbuf_u64 block_idx;
+    rbuf_u32 block_offs;
+    rbuf_u32 rest_size;
+
+    block_idx = rbuf_block_idx(ctx, ctx->cache.buff_size);
+    block_offs = rbuf_block_offs(ctx, ctx->cache.buff_size);
+
+    /* the concurrent copying grows nothing, so every append
+       takes the slow path, which refuses to grow the buffer. */
+    if (block_idx >= ctx->cache.block_num ||
+        RBUF_IS_CONCURRENT(ctx)) {
+        ctx->cache.tail_ptr = NULL;
+        ctx->cache.tail_rest = 0;
+
+        return;
+    }
+
+    /* a shared last block is copied by the slow path before it is written. */
+    if (ctx->cache.shared &&
+        rbuf_chunk_refs(rbuf_chunk_of(ctx, (rbuf_u32)block_idx)) > 1) {
+        ctx->cache.tail_ptr = NULL;
+        ctx->cache.tail_rest = 0;
+
+        return;
+    }
+
+    rest_size = rbuf_block_size(ctx, block_idx) - block_offs;
+    if (ctx->conf.size_max != 0 &&
+        rest_size > ctx->conf.size_max - ctx->cache.buff_size) {
+        rest_size = (rbuf_u32)(ctx->conf.size_max - ctx->cache.buff_size);
+    }
+
+    ctx->cache.tail_ptr = ctx->tab.blocks[block_idx] + block_offs;
+    ctx->cache.tail_rest = rest_size;
+}
+
+/**
+ * @brief update the cached buffer size and the append position.
+ * 
+ * @param ctx context pointer.
+ * @param size the new size.
+*/
+static void rbuf_size_update(rbuf_ctx *ctx, rbuf_u64 size) {
+    ctx->cache.buff_size = size;
+
+    rbuf_tail_update(ctx);
+}
+
+/**
+ * @brief grow the resizable buffer to the specified number of blocks,
+ *        the buffer size is left unchanged.
+ * 
+ * @param ctx context pointer.
+ * @param block_num the new number of blocks.
+*/
+static rbuf_res rbuf_block_grow(rbuf_ctx *ctx, rbuf_u32 block_num) {
+    rbuf_res res;
+
+    res = rbuf_tab_reserve(ctx, block_num);
+    if (res != RBUF_OK) {
+        return res;
+    }
+
+    res = rbuf_chunk_alloc(ctx, ctx->cache.block_num, block_num);
+    if (res != RBUF_OK) {
+        return res;
+    }
+
+    ctx->cache.block_num = block_num;
+    ctx->cache.buff_cap = rbuf_block_cap(ctx, block_num);
+
+#ifdef RBUF_STATS
+    if (ctx->stats.buff_cap_peak < ctx->cache.buff_cap) {
+        ctx->stats.buff_cap_peak = ctx->cache.buff_cap;
+    }
+#endif
+
+    rbuf_tail_update(ctx);
+
+    return RBUF_OK;
+}
+
+/**
+ * @brief make the blocks holding a range of the resizable buffer private
+ *        before they are written.
+ * 
+ * @param ctx context pointer.
+ * @param offs offset indicating where the range starts in the resizable buffer.
+ * @param size size of the range.
+*/
+static rbuf_res rbuf_cow(rbuf_ctx *ctx, rbuf_u64 offs, rbuf_u64 size) {
+    rbuf_u64 first;
+    rbuf_u64 last;
+    rbuf_res res;
+
+    if (!ctx->cache.shared ||
+        size == 0) {
+        return RBUF_OK;
+    }
+
+    first = rbuf_block_idx(ctx, offs);
+    last = rbuf_block_idx(ctx, offs + size - 1);
+    if (last >= ctx->cache.block_num) {
+        last = (rbuf_u64)ctx->cache.block_num - 1;
+    }
+
+    for (rbuf_u64 i = first; i <= last && i < ctx->cache.block_num; i++) {
+
+        /* the first block of each slab chunk stands for the chunk. */
+        if (i != first &&
+            (ctx->tab.phase + i) % ctx->conf.slab_block_num != 0) {
+            continue;
+        }
+
+        res = rbuf_chunk_unshare(ctx, (rbuf_u32)i);
+        if (res != RBUF_OK) {
+            return res;
+        }
+    }
+
+    rbuf_tail_update(ctx);
+
+    return RBUF_OK;
+}
+
+#if RBUF_INLINE_SIZE > 0
+
+/**
+ * @brief move the data of the inline block into a regular block.
+ * 
+ * @param ctx context pointer.
+*/
+static rbuf_res rbuf_inline_spill(rbuf_ctx *ctx) {
+    rbuf_res res;
+
+    ctx->cache.inline_used = false;
+
+    res = rbuf_chunk_alloc(ctx, 0, 1);
+    if (res != RBUF_OK) {
+        ctx->tab.blocks[0] = ctx->inl.buff;
+        ctx->cache.inline_used = true;
+
+        return res;
+    }
+
+    memcpy(ctx->tab.blocks[0], ctx->inl.buff, ctx->cache.head_offs + (size_t)ctx->cache.buff_size);
+
+    ctx->cache.buff_cap = rbuf_block_cap(ctx, 1);
+    rbuf_tail_update(ctx);
+
+    return RBUF_OK;
+}
+
+/**
+ * @brief prepare the blocks for the specified buffer size, using the inline
+ *        block while the buffer fits into it.
+ * 
+ * @param ctx context pointer.
+ * @param size the upcoming buffer size.
+*/
+static rbuf_res rbuf_inline_fit(rbuf_ctx *ctx, rbuf_u64 size) {
+    if (RBUF_IS_INLINE(ctx)) {
+        if (size <= RBUF_INLINE_SIZE - ctx->cache.head_offs) {
+            return RBUF_OK;
+        }
+
+        return rbuf_inline_spill(ctx);
+    }
+
+    /* the inline block only pays off when it is smaller than the first
+       regular block, and the modes below want all the blocks alike. */
+    if (ctx->cache.block_num != 0 ||
+        size == 0 ||
+        size > RBUF_INLINE_SIZE ||
+        rbuf_block_size(ctx, 0) <= RBUF_INLINE_SIZE ||
+        ctx->conf.block_align != 0 ||
+        (ctx->conf.flags & (RBUF_FLAG_SPSC | RBUF_FLAG_MMAP | RBUF_FLAG_SHARED |
+                            RBUF_FLAG_CHECKSUM)) != 0) {
+        return RBUF_OK;
+    }
+
+    if (ctx->tab.base == NULL) {
+        ctx->tab.base = &ctx->inl.slot;
+        ctx->tab.blocks = ctx->tab.base;
+        ctx->tab.cap = 1;
+        ctx->tab.borrowed = true;
+    }
+
+    ctx->tab.blocks[0] = ctx->inl.buff;
+    ctx->cache.inline_used = true;
+    ctx->cache.block_num = 1;
+    rbuf_align_note(ctx, ctx->inl.buff);
+    ctx->cache.buff_cap = rbuf_block_cap(ctx, 1);
+    rbuf_tail_update(ctx);
+
+    return RBUF_OK;
+}
+
+#else
+
+static rbuf_res rbuf_inline_fit(rbuf_ctx *ctx, rbuf_u64 size) {
+    (void)ctx;
+    (void)size;
+
+    return RBUF_OK;
+}
+
+#endif
+
+#ifdef RBUF_HAS_ATOMICS
+
+/**
+ * @brief copy data between the ring and an external buffer, wrapping
+ *        around the end of the ring.
+ * 
+ * @param ctx context pointer.
+ * @param pos ring offset to start at.
+ * @param buff external buffer pointer.
+ * @param size data copying size.
+ * @param into whether the data goes into the ring.
+*/
+static void rbuf_ring_copy(rbuf_ctx *ctx, rbuf_u32 pos, rbuf_u8 *buff, rbuf_u32 size, bool into) {
+    rbuf_u32 block_idx;
+    rbuf_u32 block_offs;
+    rbuf_u32 curt_size;
+
+    block_idx = (rbuf_u32)rbuf_block_idx(ctx, pos);
+    block_offs = rbuf_block_offs(ctx, pos);
+    while (size != 0) {
+        curt_size = ctx->conf.block_size - block_offs;
+        if (curt_size > size) {
+            curt_size = size;
+        }
+
+        if (into) {
+            memcpy(ctx->tab.blocks[block_idx] + block_offs, buff, curt_size);
+        } else {
+            memcpy(buff, ctx->tab.blocks[block_idx] + block_offs, curt_size);
+        }
+
+        buff += curt_size;
+        size -= curt_size;
+        block_offs = 0;
+
+        /* the ring is made up of whole blocks. */
+        block_idx++;
+        if (block_idx == ctx->cache.block_num) {
+            block_idx = 0;
+        }
+    }
+}
+
+/**
+ * @brief set up the single-producer/single-consumer mode, all the blocks
+ *        are allocated here.
+ * 
+ * @param ctx context pointer.
+*/
+static rbuf_res rbuf_spsc_init(rbuf_ctx *ctx) {
+    rbuf_u64 block_num;
+    rbuf_res res;
+
+    /* the ring offsets and the shared size are 32-bit. */
+    if (ctx->conf.size_max == 0 ||
+        ctx->conf.size_max > UINT32_MAX) {
+        return RBUF_ERR_BAD_SIZE;
+    }
+
+    block_num = rbuf_block_num(ctx, ctx->conf.size_max);
+    if ((rbuf_u64)ctx->conf.block_size * block_num > UINT32_MAX) {
+        return RBUF_ERR_BAD_SIZE;
+    }
+
+    res = rbuf_block_grow(ctx, (rbuf_u32)block_num);
+    if (res != RBUF_OK) {
+        return res;
+    }
+
+    /* keep the generic append fast path away from the ring. */
+    ctx->cache.tail_ptr = NULL;
+    ctx->cache.tail_rest = 0;
+
+    /* the indices stay out of the context, which is smaller for it. */
+    ctx->spsc.mem = ctx->conf.mem.alloc(ctx->conf.mem.user, sizeof(rbuf_spsc_idx) + RBUF_CACHE_LINE_SIZE - 1);
+    if (ctx->spsc.mem == NULL) {
+        return RBUF_ERR_NO_MEM;
+    }
+
+    ctx->spsc.idx = (rbuf_spsc_idx *)((rbuf_u8 *)ctx->spsc.mem +
+                                      (RBUF_CACHE_LINE_SIZE - (uintptr_t)ctx->spsc.mem % RBUF_CACHE_LINE_SIZE) %
+                                      RBUF_CACHE_LINE_SIZE);
+    memset(ctx->spsc.idx, 0, sizeof(rbuf_spsc_idx));
+    atomic_init(&ctx->spsc.idx->size, 0);
+
+    ctx->spsc.ring_len = ctx->conf.block_size * (rbuf_u32)block_num;
+
+    return RBUF_OK;
+}
+
+/**
+ * @brief append data in the single-producer/single-consumer mode,
+ *        only the producer may call it.
+ * 
+ * @param ctx context pointer.
+ * @param buff external buffer pointer.
+ * @param size data appending size.
+*/
+static rbuf_res rbuf_spsc_append(rbuf_ctx *ctx, const void *buff, rbuf_u32 size) {
+    rbuf_u32 buff_size;
+
+    /* acquire, so the consumer is done with the space being reused. */
+    buff_size = atomic_load_explicit(&ctx->spsc.idx->size, memory_order_acquire);
+    if (size > ctx->conf.size_max - buff_size) {
+        return RBUF_ERR_BAD_SIZE;
+    }
+
+    rbuf_ring_copy(ctx, ctx->spsc.idx->tail, (rbuf_u8 *)buff, size, true);
+
+    ctx->spsc.idx->tail = (rbuf_u32)(((rbuf_u64)ctx->spsc.idx->tail + size) % ctx->spsc.ring_len);
+
+    /* release, so the consumer sees the data along with the size. */
+    atomic_fetch_add_explicit(&ctx->spsc.idx->size, size, memory_order_release);
+
+    return RBUF_OK;
+}
+
+/**
+ * @brief copy data out in the single-producer/single-consumer mode,
+ *        only the consumer may call it.
+ * 
+ * @param ctx context pointer.
+ * @param buff external buffer pointer.
+ * @param offs offset from the first unconsumed byte.
+ * @param size data copying size.
+*/
+static rbuf_res rbuf_spsc_copy_to(rbuf_ctx *ctx, void *buff, rbuf_u32 offs, rbuf_u32 size) {
+    rbuf_u32 buff_size;
+
+    /* acquire, so the data is visible along with the size. */
+    buff_size = atomic_load_explicit(&ctx->spsc.idx->size, memory_order_acquire);
+    if (offs > buff_size) {
+        return RBUF_ERR_BAD_OFFS;
+    }
+
+    if (size > buff_size - offs) {
+        return RBUF_ERR_BAD_SIZE;
+    }
+
+    rbuf_ring_copy(ctx, (rbuf_u32)(((rbuf_u64)ctx->spsc.idx->head + offs) % ctx->spsc.ring_len),
+                   (rbuf_u8 *)buff, size, false);
+
+    return RBUF_OK;
+}
+
+/**
+ * @brief consume data in the single-producer/single-consumer mode,
+ *        only the consumer may call it.
+ * 
+ * @param ctx context pointer.
+ * @param size data consuming size.
+*/
+static rbuf_res rbuf_spsc_consume(rbuf_ctx *ctx, rbuf_u32 size) {
+    rbuf_u32 buff_size;
+
+    buff_size = atomic_load_explicit(&ctx->spsc.idx->size, memory_order_acquire);
+    if (size > buff_size) {
+        return RBUF_ERR_BAD_SIZE;
+    }
+
+    ctx->spsc.idx->head = (rbuf_u32)(((rbuf_u64)ctx->spsc.idx->head + size) % ctx->spsc.ring_len);
+
+    /* release, so the producer reuses the space only after the reads. */
+    atomic_fetch_sub_explicit(&ctx->spsc.idx->size, size, memory_order_release);
+
+    return RBUF_OK;
+}
+
+#else
+
+/* without atomics there is no way to synchronize the two sides,
+   so the mode can't be enabled. */
+static rbuf_res rbuf_spsc_init(rbuf_ctx *ctx) {
+    (void)ctx;
+
+    return RBUF_ERR;
+}
+
+static rbuf_res rbuf_spsc_append(rbuf_ctx *ctx, const void *buff, rbuf_u32 size) {
+    (void)ctx;
+    (void)buff;
+    (void)size;
+
+    return RBUF_ERR;
+}
+
+static rbuf_res rbuf_spsc_copy_to(rbuf_ctx *ctx, void *buff, rbuf_u32 offs, rbuf_u32 size) {
+    (void)ctx;
+    (void)buff;
+    (void)offs;
+    (void)size;
+
+    return RBUF_ERR;
+}
+
+static rbuf_res rbuf_spsc_consume(rbuf_ctx *ctx, rbuf_u32 size) {
+    (void)ctx;
+    (void)size;
+
+    return RBUF_ERR;
+}
+
+#endif
+
+/**
+ * @brief set up the adaptive mode, where the block sizes double from
+ *        the block size up to the maximum block size.
+ * 
+ * @param ctx context pointer.
+ * @param block_size_max maximum block size.
+*/
+static rbuf_res rbuf_adaptive_init(rbuf_ctx *ctx, rbuf_u32 block_size_max) {
+#ifdef RBUF_BLOCK_SHIFT
+    (void)ctx;
+    (void)block_size_max;
+
+    return RBUF_ERR_BAD_SIZE;
+#else
+    if (!ctx->conf.block_pow2 ||
+        block_size_max < ctx->conf.block_size ||
+        (block_size_max & (block_size_max - 1)) != 0) {
+        return RBUF_ERR_BAD_SIZE;
+    }
+
+    if (ctx->conf.slab_block_num != 1 ||
+        ctx->conf.spare_high != 0 ||
+        (ctx->conf.flags & (RBUF_FLAG_SPSC | RBUF_FLAG_MMAP | RBUF_FLAG_SHARED)) != 0) {
+        return RBUF_ERR;
+    }
+
+    ctx->conf.block_shift_max = rbuf_log2(block_size_max);
+    ctx->conf.grow_num = ctx->conf.block_shift_max - ctx->conf.block_shift;
+    ctx->conf.grow_size = ((rbuf_u64)ctx->conf.block_size << ctx->conf.grow_num) - ctx->conf.block_size;
+
+    return RBUF_OK;
+#endif
+}
+
+/**
+ * @brief carve the caller-supplied pool into the block index table and the
+ *        blocks, so the buffer runs on it until it grows past the pool.
+ * 
+ * @param ctx context pointer.
+ * @param pool pool memory, it is aligned for a pointer.
+ * @param pool_size size of the pool memory.
+*/
+static rbuf_res rbuf_pool_init(rbuf_ctx *ctx, void *pool, size_t pool_size) {
+    size_t block_num;
+    rbuf_u8 *block;
+
+    /* the pool blocks are plain blocks, and the free ones hold a pointer. */
+    if (ctx->conf.block_size < sizeof(rbuf_u8 *)) {
+        return RBUF_ERR_BAD_SIZE;
+    }
+
+    if (ctx->conf.slab_block_num != 1 ||
+        RBUF_IS_ADAPTIVE(ctx) ||
+        RBUF_IS_MMAP(ctx) ||
+        RBUF_IS_SHARED(ctx)) {
+        return RBUF_ERR;
+    }
+
+    block_num = pool_size / (sizeof(rbuf_u8 *) + ctx->conf.block_size);
+    if (block_num > UINT32_MAX) {
+        block_num = UINT32_MAX;
+    }
+
+    if (block_num == 0) {
+        return RBUF_ERR_BAD_SIZE;
+    }
+
+    /* the table goes first, so it keeps the alignment of the pool. */
+    ctx->tab.base = (rbuf_u8 **)pool;
+    ctx->tab.blocks = ctx->tab.base;
+    ctx->tab.cap = (rbuf_u32)block_num;
+    ctx->tab.borrowed = true;
+
+    ctx->pool.base = (rbuf_u8 *)pool + sizeof(rbuf_u8 *) * block_num;
+    ctx->pool.end = ctx->pool.base + (size_t)ctx->conf.block_size * block_num;
+    ctx->pool.free = NULL;
+
+    /* link the blocks so they are taken in address order. */
+    for (block = ctx->pool.end; block != ctx->pool.base; ) {
+        block -= ctx->conf.block_size;
+        memcpy(block, &ctx->pool.free, sizeof(rbuf_u8 *));
+        ctx->pool.free = block;
+    }
+
+    return RBUF_OK;
+}
+
+/**
+ * @brief check the configuration before any memory is touched, and
+ *        pick the allocator of the context.
+ * 
+ * @param conf configuration pointer.
+ * @param mem allocator pointer.
+*/
+static rbuf_res rbuf_conf_check(rbuf_conf *conf, rbuf_mem *mem) {
+    if (conf != NULL) {
+#ifdef RBUF_BLOCK_SHIFT
+
+        /* 0 stands for the block size fixed at compile time. */
+        if (conf->block_size != 0 &&
+            conf->block_size != RBUF_DEF_BLOCK_SIZE) {
+            return RBUF_ERR_BAD_SIZE;
+        }
+#else
+        if (conf->block_size == 0) {
+            return RBUF_ERR_BAD_SIZE;
+        }
+#endif
+
+        *mem = conf->mem;
+    } else {
+        memset(mem, 0, sizeof(rbuf_mem));
+    }
+
+    /* an allocator must come with its own deallocator. */
+    if ((mem->alloc == NULL) != (mem->free == NULL)) {
+        return RBUF_ERR;
+    }
+
+    if (mem->alloc == NULL) {
+        mem->alloc = rbuf_def_alloc;
+        mem->free = rbuf_def_free;
+        mem->realloc = rbuf_def_realloc;
+    }
+
+    return RBUF_OK;
+}
+
+/**
+ * @brief release everything the context holds, but not the context itself.
+ * 
+ * @param ctx context pointer.
+*/
+static rbuf_res rbuf_ctx_fini(rbuf_ctx *ctx) {
+    rbuf_mem mem;
+    rbuf_res res;
+
+    mem = ctx->conf.mem;
+
+    /* the mapping goes as a whole, nothing is left to release. */
+    res = RBUF_OK;
+    if (RBUF_IS_MMAP(ctx)) {
+        res = rbuf_map_del(ctx);
+        ctx->cache.block_num = 0;
+    }
+
+    rbuf_chunk_release(ctx, 0, ctx->cache.block_num);
+    if (ctx->tab.base != NULL &&
+        !ctx->tab.borrowed) {
+        mem.free(mem.user, ctx->tab.base);
+    }
+
+    rbuf_trim(ctx);
+    if (ctx->spare.chunks != NULL) {
+        mem.free(mem.user, ctx->spare.chunks);
+    }
+
+    if (ctx->sum.slots != NULL) {
+        mem.free(mem.user, ctx->sum.slots);
+    }
+
+#ifdef RBUF_HAS_ATOMICS
+    if (ctx->spsc.mem != NULL) {
+        mem.free(mem.user, ctx->spsc.mem);
+    }
+#endif
+
+    return res;
+}
+
+/**
+ * @brief set up a context in the specified memory, everything set up
+ *        so far is released when it fails.
+ * 
+ * @param ctx context pointer.
+ * @param conf configuration pointer.
+ * @param mem allocator of the context.
+*/
+static rbuf_res rbuf_ctx_init(rbuf_ctx *ctx, rbuf_conf *conf, rbuf_mem mem) {
+    rbuf_u32 block_size_max;
+    rbuf_res res;
+
+    memset(ctx, 0, sizeof(rbuf_ctx));
+
+    block_size_max = 0;
+
+    if (conf != NULL) {
+        ctx->conf.block_size = conf->block_size;
+        ctx->conf.size_max = conf->size_max;
+        ctx->conf.slab_block_num = conf->slab_block_num;
+        ctx->conf.flags = conf->flags;
+        ctx->conf.spare_low = conf->spare_low;
+        ctx->conf.spare_high = conf->spare_high;
+        ctx->conf.block_align = conf->block_align;
+        block_size_max = conf->block_size_max;
+    } else {
+        ctx->conf.block_size = RBUF_DEF_BLOCK_SIZE;
+        ctx->conf.size_max = RBUF_DEF_SIZE_MAX;
+        ctx->conf.slab_block_num = RBUF_DEF_SLAB_BLOCK_NUM;
+    }
+
+    if (ctx->conf.slab_block_num == 0) {
+        ctx->conf.slab_block_num = RBUF_DEF_SLAB_BLOCK_NUM;
+    }
+
+    ctx->conf.mem = mem;
+
+#ifdef RBUF_BLOCK_SHIFT
+    ctx->conf.block_size = RBUF_DEF_BLOCK_SIZE;
+#endif
+
+    if ((ctx->conf.block_size & (ctx->conf.block_size - 1)) == 0) {
+        ctx->conf.block_pow2 = true;
+        ctx->conf.block_mask = ctx->conf.block_size - 1;
+        while (((rbuf_u32)1 << ctx->conf.block_shift) != ctx->conf.block_size) {
+            ctx->conf.block_shift++;
+        }
+    }
+
+    if (ctx->conf.spare_low > ctx->conf.spare_high) {
+        rbuf_ctx_fini(ctx);
+
+        return RBUF_ERR;
+    }
+
+    /* the shared blocks have to be separate allocations of one size. */
+    if (RBUF_IS_SHARED(ctx) &&
+        (ctx->conf.flags & (RBUF_FLAG_SPSC | RBUF_FLAG_MMAP)) != 0) {
+        rbuf_ctx_fini(ctx);
+
+        return RBUF_ERR;
+    }
+
+    /* the concurrent copying can't copy the shared blocks
+       on writing, and has no block table in the ring. */
+    if (RBUF_IS_CONCURRENT(ctx) &&
+        (ctx->conf.flags & (RBUF_FLAG_SPSC | RBUF_FLAG_SHARED)) != 0) {
+        rbuf_ctx_fini(ctx);
+
+        return RBUF_ERR;
+    }
+
+    /* the ring has no block table, and the copying on
+       other threads would race on the CRC-32C of a block. */
+    if (RBUF_IS_SUMMED(ctx) &&
+        (ctx->conf.flags & (RBUF_FLAG_SPSC | RBUF_FLAG_CONCURRENT)) != 0) {
+        rbuf_ctx_fini(ctx);
+
+        return RBUF_ERR;
+    }
+
+    if (block_size_max != 0 &&
+        block_size_max != ctx->conf.block_size) {
+        res = rbuf_adaptive_init(ctx, block_size_max);
+        if (res != RBUF_OK) {
+            rbuf_ctx_fini(ctx);
+
+            return res;
+        }
+    }
+
+    /* the blocks of a slab chunk are only aligned as their size allows. */
+    if (RBUF_IS_ALIGNED(ctx)) {
+        if ((ctx->conf.block_align & (ctx->conf.block_align - 1)) != 0 ||
+            ctx->conf.block_align > RBUF_ALIGN_MAX ||
+            (ctx->conf.slab_block_num > 1 &&
+             ctx->conf.block_align != 0 &&
+             ctx->conf.block_size % ctx->conf.block_align != 0)) {
+            rbuf_ctx_fini(ctx);
+
+            return RBUF_ERR_BAD_SIZE;
+        }
+
+        if ((ctx->conf.flags & (RBUF_FLAG_MMAP | RBUF_FLAG_RECYCLE)) != 0 ||
+            (conf != NULL && conf->pool != NULL)) {
+            rbuf_ctx_fini(ctx);
+
+            return RBUF_ERR;
+        }
+    }
+
+    /* the recycled chunks come from malloc() and are of one size,
+       and the free ones hold a pointer. */
+    if (RBUF_IS_RECYCLED(ctx)) {
+        if (ctx->conf.mem.alloc != rbuf_def_alloc ||
+            RBUF_IS_ADAPTIVE(ctx) ||
+            (ctx->conf.flags & (RBUF_FLAG_MMAP | RBUF_FLAG_SHARED)) != 0) {
+            rbuf_ctx_fini(ctx);
+
+            return RBUF_ERR;
+        }
+
+        if ((size_t)ctx->conf.block_size * ctx->conf.slab_block_num < sizeof(rbuf_u8 *)) {
+            rbuf_ctx_fini(ctx);
+
+            return RBUF_ERR_BAD_SIZE;
+        }
+    }
+
+    if (conf != NULL &&
+        conf->pool != NULL) {
+        res = rbuf_pool_init(ctx, conf->pool, conf->pool_size);
+        if (res != RBUF_OK) {
+            rbuf_ctx_fini(ctx);
+
+            return res;
+        }
+
+        res = rbuf_sum_reserve(ctx);
+        if (res != RBUF_OK) {
+            rbuf_ctx_fini(ctx);
+
+            return res;
+        }
+    }
+
+    if (ctx->conf.spare_high != 0) {
+        if ((rbuf_u64)ctx->conf.spare_high * sizeof(rbuf_u8 *) > (rbuf_u64)SIZE_MAX) {
+            rbuf_ctx_fini(ctx);
+
+            return RBUF_ERR_NO_MEM;
+        }
+
+        ctx->spare.chunks = (rbuf_u8 **)mem.alloc(mem.user,
+                                                  sizeof(rbuf_u8 *) * ctx->conf.spare_high);
+        if (ctx->spare.chunks == NULL) {
+            rbuf_ctx_fini(ctx);
+
+            return RBUF_ERR_NO_MEM;
+        }
+    }
+
+    if ((ctx->conf.flags & RBUF_FLAG_MMAP) != 0) {
+        res = rbuf_map_init(ctx, conf->map_fd);
+        if (res != RBUF_OK) {
+            rbuf_ctx_fini(ctx);
+
+            return res;
+        }
+    }
+
+    if ((ctx->conf.flags & RBUF_FLAG_SPSC) != 0) {
+        res = rbuf_spsc_init(ctx);
+        if (res != RBUF_OK) {
+            rbuf_ctx_fini(ctx);
+
+            return res;
+        }
+    }
+
+    return RBUF_OK;
+}
+
+/**
+ * @brief fill a configuration with the defaults.
+ * 
+ * @param conf configuration pointer.
+*/
+rbuf_res rbuf_conf_init(rbuf_conf *conf) {
+    RBUF_ASSERT(conf != NULL);
+
+    memset(conf, 0, sizeof(rbuf_conf));
+    conf->block_size = RBUF_DEF_BLOCK_SIZE;
+    conf->size_max = RBUF_DEF_SIZE_MAX;
+    conf->slab_block_num = RBUF_DEF_SLAB_BLOCK_NUM;
+    conf->map_fd = RBUF_MAP_ANON;
+
+    return RBUF_OK;
+}
+
+/**
+ * @brief create a resizable buffer.
+ * 
+ * @param ctx the address of the context pointer.
+ * @param conf configuration pointer.
+*/
+rbuf_res rbuf_new(rbuf_ctx **ctx, rbuf_conf *conf) {
+    rbuf_ctx *alloc_ctx;
+    rbuf_res res;
+    rbuf_mem mem;
+
+    RBUF_ASSERT(ctx != NULL);
+
+    res = rbuf_conf_check(conf, &mem);
+    if (res != RBUF_OK) {
+        return res;
+    }
+
+    alloc_ctx = (rbuf_ctx *)mem.alloc(mem.user, sizeof(rbuf_ctx));
+    if (alloc_ctx == NULL) {
+        return RBUF_ERR_NO_MEM;
+    }
+
+    res = rbuf_ctx_init(alloc_ctx, conf, mem);
+    if (res != RBUF_OK) {
+        mem.free(mem.user, alloc_ctx);
+
+        return res;
+    }
+
+    *ctx = alloc_ctx;
+
+    return RBUF_OK;
+}
+
+/**
+ * @brief delete the resizable buffer.
+ * 
+ * @param ctx context pointer.
+*/
+rbuf_res rbuf_del(rbuf_ctx *ctx) {
+    rbuf_mem mem;
+    rbuf_res res;
+
+    RBUF_ASSERT(ctx != NULL);
+
+    mem = ctx->conf.mem;
+
+    res = rbuf_ctx_fini(ctx);
+    mem.free(mem.user, ctx);
+
+    return res;
+}
+
+/* the storage type of the header must be able to hold the context. */
+typedef char rbuf_ctx_size_check[(sizeof(rbuf_ctx) <= sizeof(rbuf_ctx_storage)) ? 1 : -1];
+
+/**
+ * @brief set up a resizable buffer in caller-supplied memory.
+ * 
+ * @param ctx the address of the context pointer.
+ * @param storage memory of the context, it must outlive the context.
+ * @param conf configuration pointer.
+*/
+rbuf_res rbuf_init(rbuf_ctx **ctx, rbuf_ctx_storage *storage, rbuf_conf *conf) {
+    rbuf_res res;
+    rbuf_mem mem;
+
+    RBUF_ASSERT(ctx != NULL);
+    RBUF_ASSERT(storage != NULL);
+
+    res = rbuf_conf_check(conf, &mem);
+    if (res != RBUF_OK) {
+        return res;
+    }
+
+    res = rbuf_ctx_init((rbuf_ctx *)storage, conf, mem);
+    if (res != RBUF_OK) {
+        return res;
+    }
+
+    *ctx = (rbuf_ctx *)storage;
+
+    return RBUF_OK;
+}
+
+/**
+ * @brief tear down a resizable buffer set up by rbuf_init(), the memory
+ *        of the context is left to the caller.
+ * 
+ * @param ctx context pointer.
+*/
+rbuf_res rbuf_deinit(rbuf_ctx *ctx) {
+    RBUF_ASSERT(ctx != NULL);
+
+    return rbuf_ctx_fini(ctx);
+}
+
+/**
+ * @brief get the status of the resizable buffer.
+ * 
+ * @param ctx context pointer.
+ * @param stat status pointer.
+*/
+rbuf_res rbuf_status64(rbuf_ctx *ctx, rbuf_stat64 *stat) {
+    RBUF_ASSERT(ctx != NULL);
+    RBUF_ASSERT(stat != NULL);
+
+    stat->block_num = ctx->cache.block_num;
+    stat->buff_size = ctx->cache.buff_size;
+    stat->block_align = (ctx->cache.block_num != 0) ? ctx->cache.block_align : 0;
+
+#ifdef RBUF_HAS_ATOMICS
+    if (RBUF_IS_SPSC(ctx)) {
+        stat->buff_size = atomic_load_explicit(&ctx->spsc.idx->size, memory_order_acquire);
+    }
+#endif
+
+    return RBUF_OK;
+}
+
+/**
+ * @brief get the status of the resizable buffer, the buffer size
+ *        saturates when it doesn't fit into 32 bits.
+ * 
+ * @param ctx context pointer.
+ * @param stat status pointer.
+*/
+rbuf_res rbuf_status(rbuf_ctx *ctx, rbuf_stat *stat) {
+    rbuf_stat64 stat64;
+
+    RBUF_ASSERT(ctx != NULL);
+    RBUF_ASSERT(stat != NULL);
+
+    rbuf_status64(ctx, &stat64);
+
+    stat->block_num = stat64.block_num;
+    stat->block_align = stat64.block_align;
+    if (stat64.buff_size > UINT32_MAX) {
+        stat->buff_size = UINT32_MAX;
+
+        return RBUF_ERR_BAD_SIZE;
+    }
+
+    stat->buff_size = (rbuf_u32)stat64.buff_size;
+
+    return RBUF_OK;
+}
+
+#ifdef RBUF_STATS
+
+/**
+ * @brief get the status of the resizable buffer along with its counters.
+ * 
+ * @param ctx context pointer.
+ * @param stat extended status pointer.
+*/
+rbuf_res rbuf_status_ext(rbuf_ctx *ctx, rbuf_stat_ext *stat) {
+    rbuf_stat64 stat64;
+
+    RBUF_ASSERT(ctx != NULL);
+    RBUF_ASSERT(stat != NULL);
+
+    rbuf_status64(ctx, &stat64);
+
+    stat->block_num = stat64.block_num;
+    stat->buff_size = stat64.buff_size;
+    stat->buff_cap = ctx->cache.buff_cap;
+    stat->block_align = stat64.block_align;
+    stat->counters = ctx->stats;
+
+    return RBUF_OK;
+}
+
+#endif
+
+/**
+ * @brief resize the buffer size of the resizable buffer.
+ * 
+ * @param ctx context pointer.
+ * @param size the new size.
+*/
+rbuf_res rbuf_resize64(rbuf_ctx *ctx, rbuf_u64 size) {
+    rbuf_u64 new_block_num;
+    rbuf_res res;
+
+    RBUF_ASSERT(ctx != NULL);
+
+    /* the ring of the single-producer/single-consumer mode is fixed. */
+    if (RBUF_IS_SPSC(ctx)) {
+        return RBUF_ERR;
+    }
+
+    RBUF_STAT_ADD(ctx, resize_num, 1);
+
+    /* check whether the size is too large. */
+    if (size > RBUF_SIZE_LIMIT ||
+        (ctx->conf.size_max != 0 &&
+         size > ctx->conf.size_max)) {
+        return RBUF_ERR_BAD_SIZE;
+    }
+
+    res = rbuf_inline_fit(ctx, size);
+    if (res != RBUF_OK) {
+        return res;
+    }
+
+    new_block_num = rbuf_block_num(ctx, size);
+    if (new_block_num > UINT32_MAX) {
+        return RBUF_ERR_BAD_SIZE;
+    }
+
+    /* the blocks after the one holding the new end are released. */
+    if (size < ctx->cache.buff_size) {
+        rbuf_lin_drop(ctx, size, ctx->cache.buff_size - size);
+        rbuf_sum_drop(ctx, size, 1);
+    }
+
+    if (new_block_num > ctx->cache.block_num) {
+        res = rbuf_block_grow(ctx, (rbuf_u32)new_block_num);
+        if (res != RBUF_OK) {
+            return res;
+        }
+    } else if (new_block_num < ctx->cache.block_num) {
+
+        /* release the blocks from the tail, so the
+           data in the remaining blocks is preserved. */
+        rbuf_chunk_release(ctx, (rbuf_u32)new_block_num, ctx->cache.block_num);
+        if (new_block_num == 0) {
+            rbuf_head_reset(ctx);
+        }
+
+        ctx->cache.block_num = (rbuf_u32)new_block_num;
+        ctx->cache.buff_cap = rbuf_block_cap(ctx, (rbuf_u32)new_block_num);
+    }
+
+    rbuf_size_update(ctx, size);
+
+    return RBUF_OK;
+}
+
+/**
+ * @brief resize the buffer size of the resizable buffer.
+ * 
+ * @param ctx context pointer.
+ * @param size the new size.
+*/
+rbuf_res rbuf_resize(rbuf_ctx *ctx, rbuf_u32 size) {
+    return rbuf_resize64(ctx, size);
+}
+
+/**
+ * @brief release all the spare slab chunks kept by shrinking.
+ * 
+ * @param ctx context pointer.
+*/
+rbuf_res rbuf_trim(rbuf_ctx *ctx) {
+    RBUF_ASSERT(ctx != NULL);
+
+    if (ctx->lin.buff != NULL) {
+        ctx->conf.mem.free(ctx->conf.mem.user, ctx->lin.buff);
+        ctx->lin.buff = NULL;
+        ctx->lin.cap = 0;
+        ctx->lin.size = 0;
+    }
+
+    while (ctx->spare.num != 0) {
+        ctx->spare.num--;
+        rbuf_chunk_free(ctx, ctx->spare.chunks[ctx->spare.num]);
+    }
+
+    return RBUF_OK;
+}
+
+/**
+ * @brief copy external data into the resizable buffer.
+ * 
+ * @param ctx context pointer.
+ * @param buff external buffer pointer.
+ * @param offs offset indicating where to start copying in the resizable buffer.
+ * @param size data copying size;
+*/
+rbuf_res rbuf_copy_from64(rbuf_ctx *ctx, const void *buff, rbuf_u64 offs, rbuf_u64 size) {
+    rbuf_u64 new_size;
+    rbuf_u32 block_idx;
+    rbuf_u32 block_offs;
+    rbuf_u64 buff_offs;
+    rbuf_u64 rest_size;
+    rbuf_u32 curt_size;
+    rbuf_res res;
+
+    RBUF_ASSERT(ctx != NULL);
+    RBUF_ASSERT(buff != NULL);
+
+    if (RBUF_IS_SPSC(ctx)) {
+        return RBUF_ERR;
+    }
+
+    if (offs > RBUF_SIZE_LIMIT ||
+        size > RBUF_SIZE_LIMIT - offs) {
+        return RBUF_ERR_BAD_SIZE;
+    }
+
+    new_size = offs + size;
+
+    /* the concurrent copying has to leave the blocks as they are. */
+    if (RBUF_IS_CONCURRENT(ctx) &&
+        new_size > ctx->cache.buff_size) {
+        return RBUF_ERR_BAD_SIZE;
+    }
+
+    rbuf_lin_drop(ctx, offs, size);
+    rbuf_sum_drop(ctx, offs, size);
+
+    res = rbuf_cow(ctx, offs, size);
+    if (res != RBUF_OK) {
+        return res;
+    }
+
+    /* if the new buffer size is greater than
+       the buffer size, resize the buffer. */
+    if (new_size > ctx->cache.buff_size) {
+        res = rbuf_resize64(ctx, new_size);
+        if (res != RBUF_OK) {
+            return res;
+        }
+    }
+
+    /* resolve the starting block once, then
+       walk the following blocks in sequence. */
+    block_idx = (rbuf_u32)rbuf_block_idx(ctx, offs);
+    block_offs = rbuf_block_offs(ctx, offs);
+
+    RBUF_STAT_COPY(ctx, copy_from_num, 1);
+    RBUF_STAT_COPY(ctx, copy_from_span_num, (size > rbuf_block_size(ctx, block_idx) - block_offs) ? 1 : 0);
+    RBUF_STAT_COPY(ctx, copy_in_size, size);
+
+    buff_offs = 0;
+    rest_size = size;
+    while (rest_size != 0) {
+        curt_size = rbuf_block_size(ctx, block_idx) - block_offs;
+        if (curt_size > rest_size) {
+            curt_size = (rbuf_u32)rest_size;
+        }
+
+        memcpy(ctx->tab.blocks[block_idx] + block_offs,
+               (const rbuf_u8 *)buff + buff_offs, curt_size);
+        if (RBUF_IS_SUMMED(ctx)) {
+            rbuf_sum_add(ctx, block_idx, block_offs, curt_size);
+        }
+
+        buff_offs += curt_size;
+        rest_size -= curt_size;
+        block_idx++;
+        block_offs = 0;
+    }
+
+    return RBUF_OK;
+}
+
+/**
+ * @brief copy external data into the resizable buffer.
+ * 
+ * @param ctx context pointer.
+ * @param buff external buffer pointer.
+ * @param offs offset indicating where to start copying in the resizable buffer.
+ * @param size data copying size;
+*/
+rbuf_res rbuf_copy_from(rbuf_ctx *ctx, const void *buff, rbuf_u32 offs, rbuf_u32 size) {
+    return rbuf_copy_from64(ctx, buff, offs, size);
+}
+
+/**
+ * @brief append external data to the end of the resizable buffer.
+ * 
+ * @param ctx context pointer.
+ * @param buff external buffer pointer.
+ * @param size data appending size;
+*/
+rbuf_res rbuf_append(rbuf_ctx *ctx, const void *buff, rbuf_u32 size) {
+    rbuf_res res;
+
+    RBUF_ASSERT(ctx != NULL);
+    RBUF_ASSERT(buff != NULL);
+
+    /* fast path, the data fits into the last block. */
+    if (ctx->cache.tail_ptr != NULL &&
+        size <= ctx->cache.tail_rest) {
+        memcpy(ctx->cache.tail_ptr, buff, size);
+        RBUF_STAT_ADD(ctx, copy_in_size, size);
+        if (RBUF_IS_SUMMED(ctx)) {
+            rbuf_sum_add(ctx, (rbuf_u32)rbuf_block_idx(ctx, ctx->cache.buff_size),
+                         rbuf_block_offs(ctx, ctx->cache.buff_size), size);
+        }
+
+        ctx->cache.tail_ptr += size;
+        ctx->cache.tail_rest -= size;
+        ctx->cache.buff_size += size;
+
+        return RBUF_OK;
+    }
+
+    if (RBUF_IS_SPSC(ctx)) {
+        return rbuf_spsc_append(ctx, buff, size);
+    }
+
+    res = rbuf_copy_from64(ctx, buff, ctx->cache.buff_size, size);
+    return res;
+}
+
+/**
+ * @brief reserve writable space right after the end of the resizable buffer,
+ *        a new block is added when the last block is full.
+ * 
+ * @param ctx context pointer.
+ * @param ptr the address of the pointer to the writable space.
+ * @param size the address of the size of the writable space, it is never 0.
+*/
+rbuf_res rbuf_reserve(rbuf_ctx *ctx, void **ptr, rbuf_u32 *size) {
+    rbuf_u32 block_offs;
+    rbuf_u32 rest_size;
+    rbuf_res res;
+
+    RBUF_ASSERT(ctx != NULL);
+    RBUF_ASSERT(ptr != NULL);
+    RBUF_ASSERT(size != NULL);
+
+    if (RBUF_IS_SPSC(ctx)) {
+        return RBUF_ERR;
+    }
+
+    /* the concurrent copying has to leave the buffer size as it is. */
+    if (RBUF_IS_CONCURRENT(ctx)) {
+        return RBUF_ERR_BAD_SIZE;
+    }
+
+    if (ctx->conf.size_max != 0 &&
+        ctx->cache.buff_size >= ctx->conf.size_max) {
+        return RBUF_ERR_BAD_SIZE;
+    }
+
+    res = rbuf_inline_fit(ctx, ctx->cache.buff_size + 1);
+    if (res != RBUF_OK) {
+        return res;
+    }
+
+    res = rbuf_cow(ctx, ctx->cache.buff_size, 1);
+    if (res != RBUF_OK) {
+        return res;
+    }
+
+    if (ctx->cache.buff_size == ctx->cache.buff_cap) {
+        if (ctx->cache.block_num == UINT32_MAX) {
+            return RBUF_ERR_BAD_SIZE;
+        }
+
+        res = rbuf_block_grow(ctx, ctx->cache.block_num + 1);
+        if (res != RBUF_OK) {
+            return res;
+        }
+    }
+
+    block_offs = rbuf_block_offs(ctx, ctx->cache.buff_size);
+    rest_size = rbuf_block_size(ctx, rbuf_block_idx(ctx, ctx->cache.buff_size)) - block_offs;
+    if (ctx->conf.size_max != 0 &&
+        rest_size > ctx->conf.size_max - ctx->cache.buff_size) {
+        rest_size = (rbuf_u32)(ctx->conf.size_max - ctx->cache.buff_size);
+    }
+
+    *ptr = ctx->tab.blocks[rbuf_block_idx(ctx, ctx->cache.buff_size)] + block_offs;
+    *size = rest_size;
+
+    return RBUF_OK;
+}
+
+/**
+ * @brief commit the data written into the space returned by rbuf_reserve(),
+ *        the buffer size grows by the committed size.
+ * 
+ * @param ctx context pointer.
+ * @param size size of the data actually written, it can be smaller than
+ *             the reserved size.
+*/
+rbuf_res rbuf_commit(rbuf_ctx *ctx, rbuf_u32 size) {
+    RBUF_ASSERT(ctx != NULL);
+
+    if (RBUF_IS_SPSC(ctx)) {
+        return RBUF_ERR;
+    }
+
+    if (RBUF_IS_CONCURRENT(ctx)) {
+        return RBUF_ERR_BAD_SIZE;
+    }
+
+    if (size > ctx->cache.buff_cap - ctx->cache.buff_size) {
+        return RBUF_ERR_BAD_SIZE;
+    }
+
+    if (ctx->conf.size_max != 0 &&
+        size > ctx->conf.size_max - ctx->cache.buff_size) {
+        return RBUF_ERR_BAD_SIZE;
+    }
+
+    rbuf_sum_add_range(ctx, ctx->cache.buff_size, size);
+    rbuf_size_update(ctx, ctx->cache.buff_size + size);
+
+    return RBUF_OK;
+}
+
+/**
+ * @brief consume data from the front of the resizable buffer, the blocks
+ *        which are fully consumed are released right away.
+ * 
+ * @param ctx context pointer.
+ * @param size data consuming size.
+*/
+rbuf_res rbuf_consume(rbuf_ctx *ctx, rbuf_u32 size) {
+    rbuf_u32 block_num_diff;
+    rbuf_u32 new_head_offs;
+
+    RBUF_ASSERT(ctx != NULL);
+
+    if (RBUF_IS_SPSC(ctx)) {
+        return rbuf_spsc_consume(ctx, size);
+    }
+
+    if (size > ctx->cache.buff_size) {
+        return RBUF_ERR_BAD_SIZE;
+    }
+
+    if (size == ctx->cache.buff_size) {
+        return rbuf_resize(ctx, 0);
+    }
+
+    /* the contiguous copy follows the data it was made from. */
+    if (ctx->lin.offs >= size) {
+        ctx->lin.offs -= size;
+    } else {
+        ctx->lin.size = 0;
+    }
+
+    block_num_diff = (rbuf_u32)rbuf_block_idx(ctx, size);
+    new_head_offs = rbuf_block_offs(ctx, size);
+
+    rbuf_chunk_release(ctx, 0, block_num_diff);
+
+    /* the released slots are reused when the table is compacted. */
+    ctx->tab.blocks += block_num_diff;
+    ctx->tab.phase = (ctx->tab.phase + block_num_diff) % ctx->conf.slab_block_num;
+
+#ifndef RBUF_BLOCK_SHIFT
+    if (RBUF_IS_ADAPTIVE(ctx)) {
+        ctx->tab.first_no += block_num_diff;
+        ctx->tab.first_pos = rbuf_geo_start(ctx, ctx->tab.first_no);
+    }
+#endif
+
+    ctx->cache.block_num -= block_num_diff;
+    ctx->cache.head_offs = new_head_offs;
+    ctx->cache.buff_cap = rbuf_block_cap(ctx, ctx->cache.block_num);
+
+    rbuf_size_update(ctx, ctx->cache.buff_size - size);
+
+    return RBUF_OK;
+}
+
+/**
+ * @brief copy data in the resizable buffer into the external buffer.
+ * 
+ * @param ctx context pointer.
+ * @param buff external buffer pointer.
+ * @param offs offset indicating where to start copying in the resizable buffer.
+ * @param size data copying size;
+*/
+rbuf_res rbuf_copy_to64(rbuf_ctx *ctx, void *buff, rbuf_u64 offs, rbuf_u64 size) {
+    rbuf_u32 block_idx;
+    rbuf_u32 block_offs;
+    rbuf_u64 buff_offs;
+    rbuf_u64 rest_size;
+    rbuf_u32 curt_size;
+
+    RBUF_ASSERT(ctx != NULL);
+    RBUF_ASSERT(buff != NULL);
+
+    if (RBUF_IS_SPSC(ctx)) {
+        if (offs > UINT32_MAX ||
+            size > UINT32_MAX) {
+            return RBUF_ERR_BAD_SIZE;
+        }
+
+        return rbuf_spsc_copy_to(ctx, buff, (rbuf_u32)offs, (rbuf_u32)size);
+    }
+
+    if (offs > ctx->cache.buff_size) {
+        return RBUF_ERR_BAD_OFFS;
+    }
+
+    if (size > ctx->cache.buff_size - offs) {
+        return RBUF_ERR_BAD_SIZE;
+    }
+
+    /* resolve the starting block once, then
+       walk the following blocks in sequence. */
+    block_idx = (rbuf_u32)rbuf_block_idx(ctx, offs);
+    block_offs = rbuf_block_offs(ctx, offs);
+
+    RBUF_STAT_COPY(ctx, copy_to_num, 1);
+    RBUF_STAT_COPY(ctx, copy_to_span_num, (size > rbuf_block_size(ctx, block_idx) - block_offs) ? 1 : 0);
+    RBUF_STAT_COPY(ctx, copy_out_size, size);
+
+    buff_offs = 0;
+    rest_size = size;
+    while (rest_size != 0) {
+        curt_size = rbuf_block_size(ctx, block_idx) - block_offs;
+        if (curt_size > rest_size) {
+            curt_size = (rbuf_u32)rest_size;
+        }
+
+        memcpy((rbuf_u8 *)buff + buff_offs,
+               ctx->tab.blocks[block_idx] + block_offs, curt_size);
+
+        buff_offs += curt_size;
+        rest_size -= curt_size;
+        block_idx++;
+        block_offs = 0;
+    }
+
+    return RBUF_OK;
+}
+
+/**
+ * @brief copy data in the resizable buffer into the external buffer.
+ * 
+ * @param ctx context pointer.
+ * @param buff external buffer pointer.
+ * @param offs offset indicating where to start copying in the resizable buffer.
+ * @param size data copying size;
+*/
+rbuf_res rbuf_copy_to(rbuf_ctx *ctx, void *buff, rbuf_u32 offs, rbuf_u32 size) {
+    return rbuf_copy_to64(ctx, buff, offs, size);
+}
+
+/**
+ * @brief copy several ranges of the resizable buffer into external buffers,
+ *        all the ranges are checked before any is copied.
+ * 
+ * @param ctx context pointer.
+ * @param ranges range array, "buff" of each range is the external buffer.
+ * @param num number of ranges.
+*/
+rbuf_res rbuf_copy_to_batch(rbuf_ctx *ctx, const rbuf_range *ranges, rbuf_u32 num) {
+    rbuf_u32 block_idx;
+    rbuf_u32 block_offs;
+    rbuf_u64 buff_offs;
+    rbuf_u64 rest_size;
+    rbuf_u32 curt_size;
+    rbuf_res res;
+
+    RBUF_ASSERT(ctx != NULL);
+    RBUF_ASSERT(ranges != NULL || num == 0);
+
+    if (RBUF_IS_SPSC(ctx)) {
+        for (rbuf_u32 i = 0; i < num; i++) {
+            res = rbuf_copy_to64(ctx, ranges[i].buff, ranges[i].offs, ranges[i].size);
+            if (res != RBUF_OK) {
+                return res;
+            }
+        }
+
+        return RBUF_OK;
+    }
+
+    for (rbuf_u32 i = 0; i < num; i++) {
+        RBUF_ASSERT(ranges[i].buff != NULL || ranges[i].size == 0);
+
+        if (ranges[i].offs > ctx->cache.buff_size) {
+            return RBUF_ERR_BAD_OFFS;
+        }
+
+        if (ranges[i].size > ctx->cache.buff_size - ranges[i].offs) {
+            return RBUF_ERR_BAD_SIZE;
+        }
+    }
+
+    for (rbuf_u32 i = 0; i < num; i++) {
+        rest_size = ranges[i].size;
+        if (rest_size == 0) {
+            continue;
+        }
+
+        block_idx = (rbuf_u32)rbuf_block_idx(ctx, ranges[i].offs);
+        block_offs = rbuf_block_offs(ctx, ranges[i].offs);
+
+        RBUF_STAT_COPY(ctx, copy_to_num, 1);
+        RBUF_STAT_COPY(ctx, copy_to_span_num, (rest_size > rbuf_block_size(ctx, block_idx) - block_offs) ? 1 : 0);
+        RBUF_STAT_COPY(ctx, copy_out_size, rest_size);
+
+        buff_offs = 0;
+        while (rest_size != 0) {
+            curt_size = rbuf_block_size(ctx, block_idx) - block_offs;
+            if (curt_size > rest_size) {
+                curt_size = (rbuf_u32)rest_size;
+            }
+
+            memcpy((rbuf_u8 *)ranges[i].buff + buff_offs,
+                   ctx->tab.blocks[block_idx] + block_offs, curt_size);
+
+            buff_offs += curt_size;
+            rest_size -= curt_size;
+            block_idx++;
+            block_offs = 0;
+        }
+    }
+
+    return RBUF_OK;
+}
+
+/**
+ * @brief copy several external buffers into ranges of the resizable buffer,
+ *        no range is copied unless all of them are valid.
+ * 
+ * @param ctx context pointer.
+ * @param ranges range array, "buff" of each range is the external buffer.
+ * @param num number of ranges.
+*/
+rbuf_res rbuf_copy_from_batch(rbuf_ctx *ctx, const rbuf_range *ranges, rbuf_u32 num) {
+    rbuf_u64 new_size;
+    rbuf_u32 block_idx;
+    rbuf_u32 block_offs;
+    rbuf_u64 buff_offs;
+    rbuf_u64 rest_size;
+    rbuf_u32 curt_size;
+    rbuf_res res;
+
+    RBUF_ASSERT(ctx != NULL);
+    RBUF_ASSERT(ranges != NULL || num == 0);
+
+    if (RBUF_IS_SPSC(ctx)) {
+        return RBUF_ERR;
+    }
+
+    new_size = ctx->cache.buff_size;
+    for (rbuf_u32 i = 0; i < num; i++) {
+        RBUF_ASSERT(ranges[i].buff != NULL || ranges[i].size == 0);
+
+        if (ranges[i].offs > RBUF_SIZE_LIMIT ||
+            ranges[i].size > RBUF_SIZE_LIMIT - ranges[i].offs) {
+            return RBUF_ERR_BAD_SIZE;
+        }
+
+        if (new_size < ranges[i].offs + ranges[i].size) {
+            new_size = ranges[i].offs + ranges[i].size;
+        }
+    }
+
+    if (num == 0) {
+        return RBUF_OK;
+    }
+
+    if (RBUF_IS_CONCURRENT(ctx) &&
+        new_size > ctx->cache.buff_size) {
+        return RBUF_ERR_BAD_SIZE;
+    }
+
+    for (rbuf_u32 i = 0; i < num; i++) {
+        rbuf_lin_drop(ctx, ranges[i].offs, ranges[i].size);
+
+        res = rbuf_cow(ctx, ranges[i].offs, ranges[i].size);
+        if (res != RBUF_OK) {
+            return res;
+        }
+    }
+
+    if (new_size > ctx->cache.buff_size) {
+        res = rbuf_resize64(ctx, new_size);
+        if (res != RBUF_OK) {
+            return res;
+        }
+    }
+
+    for (rbuf_u32 i = 0; i < num; i++) {
+        rest_size = ranges[i].size;
+        if (rest_size == 0) {
+            continue;
+        }
+
+        /* a range may overwrite the bytes hashed along with an earlier one. */
+        rbuf_sum_drop(ctx, ranges[i].offs, rest_size);
+
+        block_idx = (rbuf_u32)rbuf_block_idx(ctx, ranges[i].offs);
+        block_offs = rbuf_block_offs(ctx, ranges[i].offs);
+
+        RBUF_STAT_COPY(ctx, copy_from_num, 1);
+        RBUF_STAT_COPY(ctx, copy_from_span_num, (rest_size > rbuf_block_size(ctx, block_idx) - block_offs) ? 1 : 0);
+        RBUF_STAT_COPY(ctx, copy_in_size, rest_size);
+
+        buff_offs = 0;
+        while (rest_size != 0) {
+            curt_size = rbuf_block_size(ctx, block_idx) - block_offs;
+            if (curt_size > rest_size) {
+                curt_size = (rbuf_u32)rest_size;
+            }
+
+            memcpy(ctx->tab.blocks[block_idx] + block_offs,
+                   (const rbuf_u8 *)ranges[i].buff + buff_offs, curt_size);
+            if (RBUF_IS_SUMMED(ctx)) {
+                rbuf_sum_add(ctx, block_idx, block_offs, curt_size);
+            }
+
+            buff_offs += curt_size;
+            rest_size -= curt_size;
+            block_idx++;
+            block_offs = 0;
+        }
+    }
+
+    return RBUF_OK;
+}
+
+/**
+ * @brief copy external data into a range of the resizable buffer which
+ *        already exists, nothing but the blocks is touched.
+ * 
+ * @param ctx context pointer.
+ * @param offs offset indicating where the range starts in the resizable buffer.
+ * @param buff external buffer pointer.
+ * @param size size of the range.
+*/
+static void rbuf_range_put(rbuf_ctx *ctx, rbuf_u64 offs, const void *buff, rbuf_u64 size) {
+    rbuf_u32 block_idx;
+    rbuf_u32 block_offs;
+    rbuf_u64 buff_offs;
+    rbuf_u32 curt_size;
+
+    if (size == 0) {
+        return;
+    }
+
+    block_idx = (rbuf_u32)rbuf_block_idx(ctx, offs);
+    block_offs = rbuf_block_offs(ctx, offs);
+
+    buff_offs = 0;
+    while (buff_offs != size) {
+        curt_size = rbuf_block_size(ctx, block_idx) - block_offs;
+        if (curt_size > size - buff_offs) {
+            curt_size = (rbuf_u32)(size - buff_offs);
+        }
+
+        memcpy(ctx->tab.blocks[block_idx] + block_offs,
+               (const rbuf_u8 *)buff + buff_offs, curt_size);
+
+        buff_offs += curt_size;
+        block_idx++;
+        block_offs = 0;
+    }
+}
+
+/**
+ * @brief split a range of the resizable buffer into parts of about the same
+ *        size, ending at the block boundaries.
+ * 
+ * @param ctx context pointer.
+ * @param buff external buffer the range is copied from or to,
+ *             "buff" of each part points to its share of it, it isn't
+ *             const since rbuf_copy_to_batch() may write through the parts.
+ * @param offs offset indicating where the range starts in the resizable buffer.
+ * @param size size of the range.
+ * @param parts part array.
+ * @param part_num the address of the part number, it holds the capacity of
+ *                 the array on entry and the number of filled parts on return,
+ *                 which is smaller when the range has fewer blocks.
+*/
+rbuf_res rbuf_split(rbuf_ctx *ctx, void *buff, rbuf_u64 offs, rbuf_u64 size, rbuf_range *parts, rbuf_u32 *part_num) {
+    rbuf_u64 part_offs;
+    rbuf_u64 part_end;
+    rbuf_u64 step;
+    rbuf_u32 num;
+
+    RBUF_ASSERT(ctx != NULL);
+    RBUF_ASSERT(buff != NULL || size == 0);
+    RBUF_ASSERT(part_num != NULL);
+    RBUF_ASSERT(parts != NULL || *part_num == 0);
+
+    if (RBUF_IS_SPSC(ctx) ||
+        *part_num == 0) {
+        return RBUF_ERR;
+    }
+
+    if (offs > RBUF_SIZE_LIMIT ||
+        size > RBUF_SIZE_LIMIT - offs) {
+        return RBUF_ERR_BAD_SIZE;
+    }
+
+    step = size / *part_num;
+    part_offs = offs;
+    num = 0;
+    for (rbuf_u32 i = 1; i <= *part_num && part_offs != offs + size; i++) {
+        if (i == *part_num) {
+            part_end = offs + size;
+        } else {
+
+            /* pull the end back to the start of its block,
+               a part which is left empty is merged into the next. */
+            part_end = offs + step * i;
+            part_end -= rbuf_block_offs(ctx, part_end);
+            if (part_end <= part_offs) {
+                continue;
+            }
+        }
+
+        parts[num].offs = part_offs;
+        parts[num].size = part_end - part_offs;
+        parts[num].buff = (rbuf_u8 *)buff + (part_offs - offs);
+        num++;
+
+        part_offs = part_end;
+    }
+
+    *part_num = num;
+
+    return RBUF_OK;
+}
+
+/* parts of rbuf_copy_from_parallel() handed to the executor. */
+typedef struct _rbuf_job {
+    rbuf_ctx *ctx;
+    rbuf_range parts[RBUF_PARALLEL_MAX];
+} rbuf_job;
+
+/**
+ * @brief task of the executor copying one part.
+ * 
+ * @param arg job pointer.
+ * @param idx part index.
+*/
+static void rbuf_job_run(void *arg, rbuf_u32 idx) {
+    rbuf_job *job;
+
+    job = (rbuf_job *)arg;
+    rbuf_range_put(job->ctx, job->parts[idx].offs, job->parts[idx].buff, job->parts[idx].size);
+}
+
+/**
+ * @brief copy a large external buffer into the resizable buffer in parts
+ *        run by a caller's executor, the buffer grows once up front.
+ * 
+ * @param ctx context pointer.
+ * @param buff external buffer pointer.
+ * @param offs offset indicating where to start copying in the resizable buffer.
+ * @param size data copying size.
+ * @param part_num most parts to split the copying into, no more than
+ *                 RBUF_PARALLEL_MAX, and one per RBUF_PARALLEL_PART_MIN bytes.
+ * @param exec executor running the parts, NULL copies on the calling thread.
+ * @param user user pointer passed to the executor.
+*/
+rbuf_res rbuf_copy_from_parallel(rbuf_ctx *ctx, const void *buff, rbuf_u64 offs, rbuf_u64 size, rbuf_u32 part_num, rbuf_exec exec, void *user) {
+    rbuf_job job;
+    rbuf_u64 new_size;
+    rbuf_res res;
+
+    RBUF_ASSERT(ctx != NULL);
+    RBUF_ASSERT(buff != NULL || size == 0);
+
+    if (RBUF_IS_SPSC(ctx)) {
+        return RBUF_ERR;
+    }
+
+    if (offs > RBUF_SIZE_LIMIT ||
+        size > RBUF_SIZE_LIMIT - offs) {
+        return RBUF_ERR_BAD_SIZE;
+    }
+
+    if (part_num > size / RBUF_PARALLEL_PART_MIN) {
+        part_num = (rbuf_u32)(size / RBUF_PARALLEL_PART_MIN);
+    }
+
+    if (part_num > RBUF_PARALLEL_MAX) {
+        part_num = RBUF_PARALLEL_MAX;
+    }
+
+    if (part_num <= 1 ||
+        exec == NULL) {
+        return rbuf_copy_from64(ctx, buff, offs, size);
+    }
+
+    new_size = offs + size;
+
+    /* the concurrent copying has to leave the blocks as they are. */
+    if (RBUF_IS_CONCURRENT(ctx) &&
+        new_size > ctx->cache.buff_size) {
+        return RBUF_ERR_BAD_SIZE;
+    }
+
+    rbuf_lin_drop(ctx, offs, size);
+    rbuf_sum_drop(ctx, offs, size);
+
+    res = rbuf_cow(ctx, offs, size);
+    if (res != RBUF_OK) {
+        return res;
+    }
+
+    if (new_size > ctx->cache.buff_size) {
+        res = rbuf_resize64(ctx, new_size);
+        if (res != RBUF_OK) {
+            return res;
+        }
+    }
+
+    RBUF_STAT_COPY(ctx, copy_from_num, 1);
+    RBUF_STAT_COPY(ctx, copy_from_span_num, 1);
+    RBUF_STAT_COPY(ctx, copy_in_size, size);
+
+    /* the parts are only read from. */
+    job.ctx = ctx;
+    rbuf_split(ctx, (void *)buff, offs, size, job.parts, &part_num);
+
+    exec(user, rbuf_job_run, &job, part_num);
+
+    return RBUF_OK;
+}
+
+/**
+ * @brief move the cursor onto the block holding its position, after the
+ *        block it was on is used up, a byte at the position is available.
+ * 
+ * @param cur cursor pointer.
+*/
+static void rbuf_cursor_load(rbuf_cursor *cur) {
+    while (cur->rest == 0) {
+        if (cur->ptr != NULL) {
+            cur->block_idx++;
+            cur->block_offs = 0;
+        }
+
+        cur->ptr = cur->ctx->tab.blocks[cur->block_idx] + cur->block_offs;
+        cur->rest = rbuf_block_size(cur->ctx, cur->block_idx) - cur->block_offs;
+    }
+}
+
+/**
+ * @brief set up a cursor reading the resizable buffer from the specified offset.
+ * 
+ * @param cur cursor pointer.
+ * @param ctx context pointer.
+ * @param offs offset indicating where to start reading in the resizable buffer.
+*/
+rbuf_res rbuf_cursor_init(rbuf_cursor *cur, rbuf_ctx *ctx, rbuf_u64 offs) {
+    RBUF_ASSERT(cur != NULL);
+    RBUF_ASSERT(ctx != NULL);
+
+    if (RBUF_IS_SPSC(ctx)) {
+        return RBUF_ERR;
+    }
+
+    cur->ctx = ctx;
+
+    return rbuf_cursor_seek(cur, offs);
+}
+
+/**
+ * @brief move the cursor to the specified offset.
+ * 
+ * @param cur cursor pointer.
+ * @param offs offset in the resizable buffer, it can be the end of the buffer.
+*/
+rbuf_res rbuf_cursor_seek(rbuf_cursor *cur, rbuf_u64 offs) {
+    rbuf_ctx *ctx;
+
+    RBUF_ASSERT(cur != NULL);
+
+    ctx = cur->ctx;
+    if (offs > ctx->cache.buff_size) {
+        return RBUF_ERR_BAD_OFFS;
+    }
+
+    cur->offs = offs;
+    cur->block_idx = (rbuf_u32)rbuf_block_idx(ctx, offs);
+    cur->block_offs = rbuf_block_offs(ctx, offs);
+    cur->ptr = NULL;
+    cur->rest = 0;
+
+    return RBUF_OK;
+}
+
+/**
+ * @brief copy data at the position of the cursor into the external buffer,
+ *        and move the cursor past it.
+ * 
+ * @param cur cursor pointer.
+ * @param buff external buffer pointer.
+ * @param size data copying size.
+*/
+rbuf_res rbuf_cursor_read(rbuf_cursor *cur, void *buff, rbuf_u64 size) {
+    rbuf_ctx *ctx;
+    rbuf_u64 buff_offs;
+    rbuf_u32 curt_size;
+
+    RBUF_ASSERT(cur != NULL);
+    RBUF_ASSERT(buff != NULL || size == 0);
+
+    ctx = cur->ctx;
+    if (cur->offs > ctx->cache.buff_size) {
+        return RBUF_ERR_BAD_OFFS;
+    }
+
+    if (size > ctx->cache.buff_size - cur->offs) {
+        return RBUF_ERR_BAD_SIZE;
+    }
+
+    if (size == 0) {
+        return RBUF_OK;
+    }
+
+    RBUF_STAT_COPY(ctx, copy_to_num, 1);
+    RBUF_STAT_COPY(ctx, copy_out_size, size);
+
+    /* most reads are served by the block the cursor is on. */
+    if (size <= cur->rest) {
+        memcpy(buff, cur->ptr, (size_t)size);
+        cur->ptr += size;
+        cur->rest -= (rbuf_u32)size;
+        cur->offs += size;
+
+        return RBUF_OK;
+    }
+
+    rbuf_cursor_load(cur);
+
+    RBUF_STAT_COPY(ctx, copy_to_span_num, (size > cur->rest) ? 1 : 0);
+
+    buff_offs = 0;
+    while (buff_offs != size) {
+        rbuf_cursor_load(cur);
+
+        curt_size = cur->rest;
+        if (curt_size > size - buff_offs) {
+            curt_size = (rbuf_u32)(size - buff_offs);
+        }
+
+        memcpy((rbuf_u8 *)buff + buff_offs, cur->ptr, curt_size);
+
+        cur->ptr += curt_size;
+        cur->rest -= curt_size;
+        buff_offs += curt_size;
+    }
+
+    cur->offs += size;
+
+    return RBUF_OK;
+}
+
+/**
+ * @brief get the contiguous data at the position of the cursor, up to the
+ *        end of its block, and move the cursor past it, no data is copied.
+ * 
+ * @param cur cursor pointer.
+ * @param ptr the address of the pointer to the data,
+ *            it is NULL at the end of the buffer.
+ * @param size the address of the data size, it is 0 at the end of the buffer.
+*/
+rbuf_res rbuf_cursor_next_chunk(rbuf_cursor *cur, void **ptr, rbuf_u32 *size) {
+    rbuf_ctx *ctx;
+    rbuf_u64 rest_size;
+    rbuf_u32 curt_size;
+
+    RBUF_ASSERT(cur != NULL);
+    RBUF_ASSERT(ptr != NULL);
+    RBUF_ASSERT(size != NULL);
+
+    ctx = cur->ctx;
+    if (cur->offs > ctx->cache.buff_size) {
+        return RBUF_ERR_BAD_OFFS;
+    }
+
+    rest_size = ctx->cache.buff_size - cur->offs;
+    if (rest_size == 0) {
+        *ptr = NULL;
+        *size = 0;
+
+        return RBUF_OK;
+    }
+
+    rbuf_cursor_load(cur);
+
+    curt_size = cur->rest;
+    if (curt_size > rest_size) {
+        curt_size = (rbuf_u32)rest_size;
+    }
+
+    *ptr = cur->ptr;
+    *size = curt_size;
+
+    cur->ptr += curt_size;
+    cur->rest -= curt_size;
+    cur->offs += curt_size;
+
+    return RBUF_OK;
+}
+
+/**
+ * @brief describe a range of the resizable buffer with pointers into its blocks,
+ *        no data is copied.
+ * 
+ * @param ctx context pointer.
+ * @param offs offset indicating where the range starts in the resizable buffer.
+ * @param size size of the range.
+ * @param iov scatter/gather array to fill.
+ * @param iovcnt the address of the element number, it holds the capacity of
+ *               the array on entry and the number of filled elements on return.
+ *               when the array is too small, only the leading part of the range
+ *               is described, its size is the sum of the filled lengths.
+*/
+rbuf_res rbuf_peek_iov(rbuf_ctx *ctx, rbuf_u32 offs, rbuf_u32 size, rbuf_iovec *iov, int *iovcnt) {
+    RBUF_ASSERT(ctx != NULL);
+    RBUF_ASSERT(iovcnt != NULL);
+    RBUF_ASSERT(iov != NULL || *iovcnt == 0);
+
+    if (RBUF_IS_SPSC(ctx)) {
+        return RBUF_ERR;
+    }
+
+    if (offs > ctx->cache.buff_size) {
+        return RBUF_ERR_BAD_OFFS;
+    }
+
+    if (size > ctx->cache.buff_size - offs) {
+        return RBUF_ERR_BAD_SIZE;
+    }
+
+    rbuf_iov_fill(ctx, offs, size, iov, iovcnt);
+
+    return RBUF_OK;
+}
+
+/**
+ * @brief get a contiguous view of a range of the resizable buffer, copied
+ *        into the context when it spans several blocks.
+ * 
+ *        the pointer is valid until the next rbuf_linearize() call or
+ *        modification of the buffer. data written through rbuf_peek_iov()
+ *        or rbuf_cursor_next_chunk() pointers isn't seen by the copy.
+ * 
+ * @param ctx context pointer.
+ * @param offs offset indicating where the range starts in the resizable buffer.
+ * @param size size of the range.
+ * @param ptr the address of the pointer to the contiguous range,
+ *            it is NULL for an empty range.
+*/
+rbuf_res rbuf_linearize(rbuf_ctx *ctx, rbuf_u64 offs, rbuf_u64 size, void **ptr) {
+    rbuf_u32 block_offs;
+    rbuf_res res;
+
+    RBUF_ASSERT(ctx != NULL);
+    RBUF_ASSERT(ptr != NULL);
+
+    if (RBUF_IS_SPSC(ctx)) {
+        return RBUF_ERR;
+    }
+
+    if (offs > ctx->cache.buff_size) {
+        return RBUF_ERR_BAD_OFFS;
+    }
+
+    if (size > ctx->cache.buff_size - offs) {
+        return RBUF_ERR_BAD_SIZE;
+    }
+
+    if (size == 0) {
+        *ptr = NULL;
+
+        return RBUF_OK;
+    }
+
+    /* the range sits inside one block. */
+    block_offs = rbuf_block_offs(ctx, offs);
+    if (size <= rbuf_block_size(ctx, rbuf_block_idx(ctx, offs)) - block_offs) {
+        *ptr = ctx->tab.blocks[rbuf_block_idx(ctx, offs)] + block_offs;
+
+        return RBUF_OK;
+    }
+
+    /* the copy would be dropped by the copying on other threads. */
+    if (RBUF_IS_CONCURRENT(ctx)) {
+        return RBUF_ERR;
+    }
+
+    if (ctx->lin.size == size &&
+        ctx->lin.offs == offs) {
+        *ptr = ctx->lin.buff;
+
+        return RBUF_OK;
+    }
+
+    if (size > (rbuf_u64)SIZE_MAX) {
+        return RBUF_ERR_NO_MEM;
+    }
+
+    /* the old copy is useless, so it isn't carried over. */
+    if (size > ctx->lin.cap) {
+        if (ctx->lin.buff != NULL) {
+            ctx->conf.mem.free(ctx->conf.mem.user, ctx->lin.buff);
+        }
+
+        ctx->lin.cap = 0;
+        ctx->lin.size = 0;
+        ctx->lin.buff = (rbuf_u8 *)ctx->conf.mem.alloc(ctx->conf.mem.user, (size_t)size);
+        if (ctx->lin.buff == NULL) {
+            RBUF_STAT_ADD(ctx, alloc_fail_num, 1);
+
+            return RBUF_ERR_NO_MEM;
+        }
+
+        ctx->lin.cap = (size_t)size;
+    }
+
+    res = rbuf_copy_to64(ctx, ctx->lin.buff, offs, size);
+    if (res != RBUF_OK) {
+        return res;
+    }
+
+    ctx->lin.offs = offs;
+    ctx->lin.size = size;
+    *ptr = ctx->lin.buff;
+
+    return RBUF_OK;
+}
+
+/**
+ * @brief compare a range of the resizable buffer with external data,
+ *        block by block.
+ * 
+ * @param ctx context pointer.
+ * @param buff external buffer pointer.
+ * @param offs offset indicating where the range starts in the resizable buffer.
+ * @param size size of the range, it must lie inside the buffer.
+*/
+static int rbuf_range_cmp(const rbuf_ctx *ctx, const void *buff, rbuf_u64 offs, rbuf_u64 size) {
+    rbuf_u32 block_idx;
+    rbuf_u32 block_offs;
+    rbuf_u64 buff_offs;
+    rbuf_u64 rest_size;
+    rbuf_u32 curt_size;
+    int diff;
+
+    block_idx = (rbuf_u32)rbuf_block_idx(ctx, offs);
+    block_offs = rbuf_block_offs(ctx, offs);
+
+    buff_offs = 0;
+    rest_size = size;
+    while (rest_size != 0) {
+        curt_size = rbuf_block_size(ctx, block_idx) - block_offs;
+        if (curt_size > rest_size) {
+            curt_size = (rbuf_u32)rest_size;
+        }
+
+        diff = memcmp(ctx->tab.blocks[block_idx] + block_offs,
+                      (const rbuf_u8 *)buff + buff_offs, curt_size);
+        if (diff != 0) {
+            return diff;
+        }
+
+        buff_offs += curt_size;
+        rest_size -= curt_size;
+        block_idx++;
+        block_offs = 0;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief find the first occurrence of a byte in a range of the resizable
+ *        buffer, block by block.
+ * 
+ * @param ctx context pointer.
+ * @param byte the byte to find.
+ * @param offs offset indicating where the range starts in the resizable buffer.
+ * @param size size of the range, it must lie inside the buffer.
+ * @param pos the address of the found offset.
+*/
+static bool rbuf_range_chr(const rbuf_ctx *ctx, rbuf_u8 byte, rbuf_u64 offs, rbuf_u64 size, rbuf_u64 *pos) {
+    rbuf_u32 block_idx;
+    rbuf_u32 block_offs;
+    rbuf_u64 buff_offs;
+    rbuf_u64 rest_size;
+    rbuf_u32 curt_size;
+    const rbuf_u8 *curt_ptr;
+    const rbuf_u8 *found;
+
+    block_idx = (rbuf_u32)rbuf_block_idx(ctx, offs);
+    block_offs = rbuf_block_offs(ctx, offs);
+
+    buff_offs = 0;
+    rest_size = size;
+    while (rest_size != 0) {
+        curt_size = rbuf_block_size(ctx, block_idx) - block_offs;
+        if (curt_size > rest_size) {
+            curt_size = (rbuf_u32)rest_size;
+        }
+
+        curt_ptr = ctx->tab.blocks[block_idx] + block_offs;
+        found = (const rbuf_u8 *)memchr(curt_ptr, byte, curt_size);
+        if (found != NULL) {
+            *pos = offs + buff_offs + (rbuf_u64)(found - curt_ptr);
+
+            return true;
+        }
+
+        buff_offs += curt_size;
+        rest_size -= curt_size;
+        block_idx++;
+        block_offs = 0;
+    }
+
+    return false;
+}
+
+/**
+ * @brief set a range of the resizable buffer to a byte,
+ *        the buffer grows when the range goes beyond its end.
+ * 
+ * @param ctx context pointer.
+ * @param byte the byte to fill with.
+ * @param offs offset indicating where to start filling in the resizable buffer.
+ * @param size data filling size.
+*/
+rbuf_res rbuf_fill(rbuf_ctx *ctx, rbuf_u8 byte, rbuf_u64 offs, rbuf_u64 size) {
+    rbuf_u64 new_size;
+    rbuf_u32 block_idx;
+    rbuf_u32 block_offs;
+    rbuf_u64 rest_size;
+    rbuf_u32 curt_size;
+    rbuf_res res;
+
+    RBUF_ASSERT(ctx != NULL);
+
+    if (RBUF_IS_SPSC(ctx)) {
+        return RBUF_ERR;
+    }
+
+    if (offs > RBUF_SIZE_LIMIT ||
+        size > RBUF_SIZE_LIMIT - offs) {
+        return RBUF_ERR_BAD_SIZE;
+    }
+
+    new_size = offs + size;
+
+    /* the concurrent copying has to leave the blocks as they are. */
+    if (RBUF_IS_CONCURRENT(ctx) &&
+        new_size > ctx->cache.buff_size) {
+        return RBUF_ERR_BAD_SIZE;
+    }
+
+    rbuf_lin_drop(ctx, offs, size);
+    rbuf_sum_drop(ctx, offs, size);
+
+    res = rbuf_cow(ctx, offs, size);
+    if (res != RBUF_OK) {
+        return res;
+    }
+
+    if (new_size > ctx->cache.buff_size) {
+        res = rbuf_resize64(ctx, new_size);
+        if (res != RBUF_OK) {
+            return res;
+        }
+    }
+
+    block_idx = (rbuf_u32)rbuf_block_idx(ctx, offs);
+    block_offs = rbuf_block_offs(ctx, offs);
+
+    rest_size = size;
+    while (rest_size != 0) {
+        curt_size = rbuf_block_size(ctx, block_idx) - block_offs;
+        if (curt_size > rest_size) {
+            curt_size = (rbuf_u32)rest_size;
+        }
+
+        memset(ctx->tab.blocks[block_idx] + block_offs, byte, curt_size);
+
+        rest_size -= curt_size;
+        block_idx++;
+        block_offs = 0;
+    }
+
+    return RBUF_OK;
+}
+
+/**
+ * @brief compare a range of the resizable buffer with external data,
+ *        no data is copied.
+ * 
+ * @param ctx context pointer.
+ * @param buff external buffer pointer.
+ * @param offs offset indicating where the range starts in the resizable buffer.
+ * @param size size of the range.
+ * @param diff the address of the result, it is less than, equal to or
+ *             greater than 0 like the one of memcmp().
+*/
+rbuf_res rbuf_compare(rbuf_ctx *ctx, const void *buff, rbuf_u64 offs, rbuf_u64 size, int *diff) {
+    RBUF_ASSERT(ctx != NULL);
+    RBUF_ASSERT(buff != NULL || size == 0);
+    RBUF_ASSERT(diff != NULL);
+
+    if (RBUF_IS_SPSC(ctx)) {
+        return RBUF_ERR;
+    }
+
+    if (offs > ctx->cache.buff_size) {
+        return RBUF_ERR_BAD_OFFS;
+    }
+
+    if (size > ctx->cache.buff_size - offs) {
+        return RBUF_ERR_BAD_SIZE;
+    }
+
+    *diff = rbuf_range_cmp(ctx, buff, offs, size);
+
+    return RBUF_OK;
+}
+
+/**
+ * @brief find the first occurrence of a byte in a range of the resizable buffer.
+ * 
+ * @param ctx context pointer.
+ * @param byte the byte to find.
+ * @param offs offset indicating where the range starts in the resizable buffer.
+ * @param size size of the range.
+ * @param pos the address of the offset where the byte is found,
+ *            RBUF_ERR_NOT_FOUND is returned when there is none.
+*/
+rbuf_res rbuf_find_byte(rbuf_ctx *ctx, rbuf_u8 byte, rbuf_u64 offs, rbuf_u64 size, rbuf_u64 *pos) {
+    RBUF_ASSERT(ctx != NULL);
+    RBUF_ASSERT(pos != NULL);
+
+    if (RBUF_IS_SPSC(ctx)) {
+        return RBUF_ERR;
+    }
+
+    if (offs > ctx->cache.buff_size) {
+        return RBUF_ERR_BAD_OFFS;
+    }
+
+    if (size > ctx->cache.buff_size - offs) {
+        return RBUF_ERR_BAD_SIZE;
+    }
+
+    if (!rbuf_range_chr(ctx, byte, offs, size, pos)) {
+        return RBUF_ERR_NOT_FOUND;
+    }
+
+    return RBUF_OK;
+}
+
+/**
+ * @brief find the first occurrence of a byte sequence in a range of the
+ *        resizable buffer, the sequence may straddle the blocks.
+ * 
+ * @param ctx context pointer.
+ * @param seq sequence pointer.
+ * @param seq_size size of the sequence, an empty one is found at "offs".
+ * @param offs offset indicating where the range starts in the resizable buffer.
+ * @param size size of the range, the sequence must lie inside it.
+ * @param pos the address of the offset where the sequence starts,
+ *            RBUF_ERR_NOT_FOUND is returned when there is none.
+*/
+rbuf_res rbuf_find_seq(rbuf_ctx *ctx, const void *seq, rbuf_u32 seq_size, rbuf_u64 offs, rbuf_u64 size, rbuf_u64 *pos) {
+    rbuf_u64 last_offs;
+    rbuf_u64 curt_offs;
+    rbuf_u64 found;
+
+    RBUF_ASSERT(ctx != NULL);
+    RBUF_ASSERT(seq != NULL || seq_size == 0);
+    RBUF_ASSERT(pos != NULL);
+
+    if (RBUF_IS_SPSC(ctx)) {
+        return RBUF_ERR;
+    }
+
+    if (offs > ctx->cache.buff_size) {
+        return RBUF_ERR_BAD_OFFS;
+    }
+
+    if (size > ctx->cache.buff_size - offs) {
+        return RBUF_ERR_BAD_SIZE;
+    }
+
+    if (seq_size == 0) {
+        *pos = offs;
+
+        return RBUF_OK;
+    }
+
+    if (seq_size > size) {
+        return RBUF_ERR_NOT_FOUND;
+    }
+
+    /* scan for the first byte, and only compare the rest there. */
+    last_offs = offs + size - seq_size;
+    curt_offs = offs;
+    while (rbuf_range_chr(ctx, *(const rbuf_u8 *)seq, curt_offs,
+                          last_offs - curt_offs + 1, &found)) {
+        if (rbuf_range_cmp(ctx, (const rbuf_u8 *)seq + 1, found + 1, seq_size - 1) == 0) {
+            *pos = found;
+
+            return RBUF_OK;
+        }
+
+        curt_offs = found + 1;
+    }
+
+    return RBUF_ERR_NOT_FOUND;
+}
+
+/**
+ * @brief whether the blocks can be added and removed anywhere in the block
+ *        index table.
+ * 
+ * @param ctx context pointer.
+*/
+static inline bool rbuf_block_movable(const rbuf_ctx *ctx) {
+    return ctx->conf.slab_block_num == 1 &&
+           !RBUF_IS_ADAPTIVE(ctx) &&
+           !RBUF_IS_INLINE(ctx) &&
+           !RBUF_IS_MMAP(ctx) &&
+           !RBUF_IS_SPSC(ctx);
+}
+
+/**
+ * @brief move a range of the resizable buffer to another offset,
+ *        the ranges may overlap, both must lie inside the blocks.
+ * 
+ * @param ctx context pointer.
+ * @param dst offset to move the range to.
+ * @param src offset of the range.
+ * @param size size of the range.
+*/
+static void rbuf_range_move(rbuf_ctx *ctx, rbuf_u64 dst, rbuf_u64 src, rbuf_u64 size) {
+    rbuf_u64 dst_idx;
+    rbuf_u64 src_idx;
+    rbuf_u32 dst_offs;
+    rbuf_u32 src_offs;
+    rbuf_u64 curt_size;
+
+    if (dst == src) {
+        return;
+    }
+
+    rbuf_sum_drop(ctx, dst, size);
+
+    /* move forward when the range moves down and backward when it moves
+       up, so the overlapping part is read before it is overwritten. */
+    if (dst < src) {
+        while (size != 0) {
+            dst_idx = rbuf_block_idx(ctx, dst);
+            src_idx = rbuf_block_idx(ctx, src);
+            dst_offs = rbuf_block_offs(ctx, dst);
+            src_offs = rbuf_block_offs(ctx, src);
+
+            curt_size = size;
+            if (curt_size > rbuf_block_size(ctx, dst_idx) - dst_offs) {
+                curt_size = rbuf_block_size(ctx, dst_idx) - dst_offs;
+            }
+
+            if (curt_size > rbuf_block_size(ctx, src_idx) - src_offs) {
+                curt_size = rbuf_block_size(ctx, src_idx) - src_offs;
+            }
+
+            memmove(ctx->tab.blocks[dst_idx] + dst_offs,
+                    ctx->tab.blocks[src_idx] + src_offs, (size_t)curt_size);
+
+            dst += curt_size;
+            src += curt_size;
+            size -= curt_size;
+        }
+    } else {
+        dst += size;
+        src += size;
+        while (size != 0) {
+            dst_idx = rbuf_block_idx(ctx, dst - 1);
+            src_idx = rbuf_block_idx(ctx, src - 1);
+            dst_offs = rbuf_block_offs(ctx, dst - 1) + 1;
+            src_offs = rbuf_block_offs(ctx, src - 1) + 1;
+
+            curt_size = size;
+            if (curt_size > dst_offs) {
+                curt_size = dst_offs;
+            }
+
+            if (curt_size > src_offs) {
+                curt_size = src_offs;
+            }
+
+            memmove(ctx->tab.blocks[dst_idx] + dst_offs - curt_size,
+                    ctx->tab.blocks[src_idx] + src_offs - curt_size, (size_t)curt_size);
+
+            dst -= curt_size;
+            src -= curt_size;
+            size -= curt_size;
+        }
+    }
+}
+
+/**
+ * @brief add the specified number of bytes in front of the data,
+ *        blocks are added to the front when the first block has no room.
+ * 
+ * @param ctx context pointer.
+ * @param size number of bytes.
+*/
+static rbuf_res rbuf_head_grow(rbuf_ctx *ctx, rbuf_u64 size) {
+    rbuf_u64 block_num;
+    bool shifted;
+    rbuf_res res;
+
+    block_num = 0;
+    if (size > ctx->cache.head_offs) {
+        block_num = (size - ctx->cache.head_offs + ctx->conf.block_size - 1) / ctx->conf.block_size;
+    }
+
+    if (block_num != 0) {
+        if (block_num > UINT32_MAX - ctx->cache.block_num) {
+            return RBUF_ERR_BAD_SIZE;
+        }
+
+        /* take the slots released last from the front, or make them. */
+        shifted = (rbuf_u64)(ctx->tab.blocks - ctx->tab.base) < block_num;
+        if (shifted) {
+            res = rbuf_tab_reserve(ctx, ctx->cache.block_num + (rbuf_u32)block_num);
+            if (res != RBUF_OK) {
+                return res;
+            }
+
+            memmove(ctx->tab.blocks + block_num, ctx->tab.blocks,
+                    sizeof(rbuf_u8 *) * ctx->cache.block_num);
+        } else {
+            ctx->tab.blocks -= block_num;
+        }
+
+        res = rbuf_chunk_alloc(ctx, 0, (rbuf_u32)block_num);
+        if (res != RBUF_OK) {
+            if (shifted) {
+                memmove(ctx->tab.blocks, ctx->tab.blocks + block_num,
+                        sizeof(rbuf_u8 *) * ctx->cache.block_num);
+            } else {
+                ctx->tab.blocks += block_num;
+            }
+
+            return res;
+        }
+
+        ctx->cache.block_num += (rbuf_u32)block_num;
+
+        /* the blocks moved to other slots. */
+        if (shifted) {
+            rbuf_sum_reset(ctx, 0, ctx->cache.block_num);
+        }
+    }
+
+    ctx->cache.head_offs = (rbuf_u32)(ctx->cache.head_offs + (rbuf_u64)ctx->conf.block_size * block_num - size);
+    ctx->cache.buff_cap = rbuf_block_cap(ctx, ctx->cache.block_num);
+
+    rbuf_size_update(ctx, ctx->cache.buff_size + size);
+
+    return RBUF_OK;
+}
+
+/**
+ * @brief add whole blocks at the specified offset, leaving the added bytes
+ *        as they are.
+ * 
+ * @param ctx context pointer.
+ * @param offs offset in the resizable buffer.
+ * @param block_num number of blocks to add.
+*/
+static rbuf_res rbuf_block_insert(rbuf_ctx *ctx, rbuf_u64 offs, rbuf_u32 block_num) {
+    rbuf_u32 block_idx;
+    rbuf_u32 block_offs;
+    rbuf_u32 move_num;
+    rbuf_res res;
+
+    if (block_num > UINT32_MAX - ctx->cache.block_num) {
+        return RBUF_ERR_BAD_SIZE;
+    }
+
+    res = rbuf_tab_reserve(ctx, ctx->cache.block_num + block_num);
+    if (res != RBUF_OK) {
+        return res;
+    }
+
+    /* the new blocks go in front of the block after the offset. */
+    block_idx = (rbuf_u32)rbuf_block_idx(ctx, offs);
+    block_offs = rbuf_block_offs(ctx, offs);
+    if (block_offs != 0) {
+        block_idx++;
+    }
+
+    move_num = ctx->cache.block_num - block_idx;
+    memmove(ctx->tab.blocks + block_idx + block_num,
+            ctx->tab.blocks + block_idx, sizeof(rbuf_u8 *) * move_num);
+
+    res = rbuf_chunk_alloc(ctx, block_idx, block_idx + block_num);
+    if (res != RBUF_OK) {
+        memmove(ctx->tab.blocks + block_idx,
+                ctx->tab.blocks + block_idx + block_num, sizeof(rbuf_u8 *) * move_num);
+
+        return res;
+    }
+
+    /* the bytes after the offset in its block keep their
+       position inside the last new block. */
+    if (block_offs != 0) {
+        memcpy(ctx->tab.blocks[block_idx + block_num - 1] + block_offs,
+               ctx->tab.blocks[block_idx - 1] + block_offs, ctx->conf.block_size - block_offs);
+    }
+
+    ctx->cache.block_num += block_num;
+    ctx->cache.buff_cap = rbuf_block_cap(ctx, ctx->cache.block_num);
+
+    /* the blocks after the new ones moved to other slots. */
+    rbuf_sum_reset(ctx, block_idx, ctx->cache.block_num);
+
+#ifdef RBUF_STATS
+    if (ctx->stats.buff_cap_peak < ctx->cache.buff_cap) {
+        ctx->stats.buff_cap_peak = ctx->cache.buff_cap;
+    }
+#endif
+
+    rbuf_size_update(ctx, ctx->cache.buff_size + (rbuf_u64)ctx->conf.block_size * block_num);
+
+    return RBUF_OK;
+}
+
+/**
+ * @brief remove whole blocks at the specified offset, only the part of the
+ *        block holding the offset which lies after it is copied.
+ * 
+ * @param ctx context pointer.
+ * @param offs offset in the resizable buffer.
+ * @param block_num the largest number of blocks to remove.
+ * @return the number of removed blocks, fewer are removed when
+ *         the blocks after the offset run out.
+*/
+static rbuf_u32 rbuf_block_erase(rbuf_ctx *ctx, rbuf_u64 offs, rbuf_u32 block_num) {
+    rbuf_u32 block_idx;
+    rbuf_u32 block_offs;
+
+    block_idx = (rbuf_u32)rbuf_block_idx(ctx, offs);
+    block_offs = rbuf_block_offs(ctx, offs);
+    if (block_offs != 0) {
+        block_idx++;
+    }
+
+    if (block_num > ctx->cache.block_num - block_idx) {
+        block_num = ctx->cache.block_num - block_idx;
+    }
+
+    if (block_num == 0) {
+        return 0;
+    }
+
+    /* the bytes which follow the removed ones take the place of the
+       part after the offset in its block, at the same position. */
+    if (block_offs != 0) {
+        memcpy(ctx->tab.blocks[block_idx - 1] + block_offs,
+               ctx->tab.blocks[block_idx + block_num - 1] + block_offs, ctx->conf.block_size - block_offs);
+    }
+
+    rbuf_chunk_release(ctx, block_idx, block_idx + block_num);
+    memmove(ctx->tab.blocks + block_idx, ctx->tab.blocks + block_idx + block_num,
+            sizeof(rbuf_u8 *) * (ctx->cache.block_num - block_idx - block_num));
+
+    ctx->cache.block_num -= block_num;
+
+    /* the block holding the offset was written, and the
+       blocks after it moved to other slots. */
+    rbuf_sum_reset(ctx, (block_offs != 0) ? block_idx - 1 : block_idx, ctx->cache.block_num);
+    if (ctx->cache.block_num == 0) {
+        rbuf_head_reset(ctx);
+    }
+
+    ctx->cache.buff_cap = rbuf_block_cap(ctx, ctx->cache.block_num);
+
+    rbuf_size_update(ctx, ctx->cache.buff_size - (rbuf_u64)ctx->conf.block_size * block_num);
+
+    return block_num;
+}
+
+/**
+ * @brief insert external data at the specified offset of the resizable buffer.
+ * 
+ * @param ctx context pointer.
+ * @param buff external buffer pointer.
+ * @param offs offset indicating where to insert in the resizable buffer.
+ * @param size data inserting size.
+*/
+rbuf_res rbuf_insert(rbuf_ctx *ctx, const void *buff, rbuf_u64 offs, rbuf_u64 size) {
+    rbuf_u64 old_size;
+    rbuf_u64 block_num;
+    rbuf_u64 rest_size;
+    bool front;
+    rbuf_res res;
+
+    RBUF_ASSERT(ctx != NULL);
+    RBUF_ASSERT(buff != NULL || size == 0);
+
+    if (RBUF_IS_SPSC(ctx)) {
+        return RBUF_ERR;
+    }
+
+    old_size = ctx->cache.buff_size;
+    if (offs > old_size) {
+        return RBUF_ERR_BAD_OFFS;
+    }
+
+    if (size > RBUF_SIZE_LIMIT - old_size ||
+        (ctx->conf.size_max != 0 &&
+         size > ctx->conf.size_max - old_size)) {
+        return RBUF_ERR_BAD_SIZE;
+    }
+
+    if (size == 0) {
+        return RBUF_OK;
+    }
+
+    /* the concurrent copying has to leave the buffer size as it is. */
+    if (RBUF_IS_CONCURRENT(ctx)) {
+        return RBUF_ERR_BAD_SIZE;
+    }
+
+    /* nothing moves, and an empty buffer could take the inline
+       block for the rest below, under the blocks added then. */
+    if (offs == old_size) {
+        return rbuf_copy_from64(ctx, buff, offs, size);
+    }
+
+    /* all the data after the offset moves. */
+    rbuf_lin_drop(ctx, offs, old_size - offs);
+
+    block_num = 0;
+    front = false;
+    if (rbuf_block_movable(ctx)) {
+        block_num = size / ctx->conf.block_size;
+        front = offs < old_size - offs;
+        if (block_num > UINT32_MAX) {
+            return RBUF_ERR_BAD_SIZE;
+        }
+    }
+
+    rest_size = size - (rbuf_u64)ctx->conf.block_size * block_num;
+
+    /* the blocks on the moving side, and the one at the offset, are written. */
+    if (front) {
+        res = rbuf_cow(ctx, 0, offs + 1);
+    } else {
+        res = rbuf_cow(ctx, offs, old_size - offs + 1);
+    }
+
+    if (res != RBUF_OK) {
+        return res;
+    }
+
+    /* make room for the rest first, it is the easy part to undo. */
+    if (rest_size != 0) {
+        if (front) {
+            res = rbuf_head_grow(ctx, rest_size);
+        } else {
+            res = rbuf_resize64(ctx, old_size + rest_size);
+        }
+
+        if (res != RBUF_OK) {
+            return res;
+        }
+    }
+
+    if (block_num != 0) {
+        res = rbuf_block_insert(ctx, front ? offs + rest_size : offs, (rbuf_u32)block_num);
+        if (res != RBUF_OK) {
+            if (front) {
+                rbuf_consume(ctx, (rbuf_u32)rest_size);
+            } else {
+                rbuf_resize64(ctx, old_size);
+            }
+
+            return res;
+        }
+    }
+
+    if (front) {
+        rbuf_range_move(ctx, 0, rest_size, offs);
+    } else {
+        rbuf_range_move(ctx, offs + size, offs + size - rest_size, old_size - offs);
+    }
+
+    return rbuf_copy_from64(ctx, buff, offs, size);
+}
+
+/**
+ * @brief erase data at the specified offset of the resizable buffer.
+ * 
+ * @param ctx context pointer.
+ * @param offs offset indicating where to erase in the resizable buffer.
+ * @param size data erasing size.
+*/
+rbuf_res rbuf_erase(rbuf_ctx *ctx, rbuf_u64 offs, rbuf_u64 size) {
+    rbuf_u64 block_num;
+    rbuf_u64 rest_size;
+    rbuf_u64 tail_size;
+    bool front;
+    rbuf_res res;
+
+    RBUF_ASSERT(ctx != NULL);
+
+    if (RBUF_IS_SPSC(ctx)) {
+        return RBUF_ERR;
+    }
+
+    if (offs > ctx->cache.buff_size) {
+        return RBUF_ERR_BAD_OFFS;
+    }
+
+    if (size > ctx->cache.buff_size - offs) {
+        return RBUF_ERR_BAD_SIZE;
+    }
+
+    if (size == 0) {
+        return RBUF_OK;
+    }
+
+    /* all the data after the offset moves. */
+    rbuf_lin_drop(ctx, offs, ctx->cache.buff_size - offs);
+
+    tail_size = ctx->cache.buff_size - offs - size;
+    front = offs < tail_size;
+
+    /* the blocks on the moving side, and the one at the offset, are written. */
+    if (front) {
+        res = rbuf_cow(ctx, 0, offs + size);
+    } else {
+        res = rbuf_cow(ctx, offs, ctx->cache.buff_size - offs);
+    }
+
+    if (res != RBUF_OK) {
+        return res;
+    }
+
+    rest_size = size;
+    if (rbuf_block_movable(ctx)) {
+        block_num = size / ctx->conf.block_size;
+        if (block_num > UINT32_MAX) {
+            block_num = UINT32_MAX;
+        }
+
+        block_num = rbuf_block_erase(ctx, offs, (rbuf_u32)block_num);
+        rest_size -= (rbuf_u64)ctx->conf.block_size * block_num;
+    }
+
+    if (rest_size == 0) {
+        return RBUF_OK;
+    }
+
+    /* move the data before the offset up, and consume the front. */
+    if (front &&
+        rest_size <= UINT32_MAX) {
+        rbuf_range_move(ctx, rest_size, 0, offs);
+
+        return rbuf_consume(ctx, (rbuf_u32)rest_size);
+    }
+
+    rbuf_range_move(ctx, offs, offs + rest_size, tail_size);
+
+    return rbuf_resize64(ctx, ctx->cache.buff_size - rest_size);
+}
+
+/**
+ * @brief create a resizable buffer sharing a range of another one.
+ * 
+ * @param ctx context pointer, it is in the "RBUF_FLAG_SHARED" mode.
+ * @param offs offset indicating where the range starts in the resizable buffer.
+ * @param size size of the range.
+ * @param slice the address of the context pointer of the new buffer,
+ *              it is deleted by rbuf_del().
+*/
+rbuf_res rbuf_slice(rbuf_ctx *ctx, rbuf_u64 offs, rbuf_u64 size, rbuf_ctx **slice) {
+    rbuf_ctx *alloc_ctx;
+    rbuf_conf conf;
+    rbuf_u32 first;
+    rbuf_u32 block_num;
+    rbuf_res res;
+
+    RBUF_ASSERT(ctx != NULL);
+    RBUF_ASSERT(slice != NULL);
+
+    if (!RBUF_IS_SHARED(ctx)) {
+        return RBUF_ERR;
+    }
+
+    if (offs > ctx->cache.buff_size) {
+        return RBUF_ERR_BAD_OFFS;
+    }
+
+    if (size > ctx->cache.buff_size - offs) {
+        return RBUF_ERR_BAD_SIZE;
+    }
+
+    rbuf_conf_init(&conf);
+    conf.block_size = ctx->conf.block_size;
+    conf.size_max = ctx->conf.size_max;
+    conf.slab_block_num = ctx->conf.slab_block_num;
+    conf.mem = ctx->conf.mem;
+    conf.flags = ctx->conf.flags;
+    conf.spare_low = ctx->conf.spare_low;
+    conf.spare_high = ctx->conf.spare_high;
+    conf.block_align = ctx->conf.block_align;
+
+    res = rbuf_new(&alloc_ctx, &conf);
+    if (res != RBUF_OK) {
+        return res;
+    }
+
+    if (size != 0) {
+        first = (rbuf_u32)rbuf_block_idx(ctx, offs);
+        block_num = (rbuf_u32)rbuf_block_num(ctx, offs + size) - first;
+
+        res = rbuf_tab_reserve(alloc_ctx, block_num);
+        if (res != RBUF_OK) {
+            rbuf_del(alloc_ctx);
+
+            return res;
+        }
+
+        /* one reference per slab chunk, like the release. */
+        for (rbuf_u32 i = first; i < first + block_num; i++) {
+            if (i == first ||
+                (ctx->tab.phase + i) % ctx->conf.slab_block_num == 0) {
+                rbuf_chunk_ref(rbuf_chunk_of(ctx, i));
+            }
+        }
+
+        memcpy(alloc_ctx->tab.blocks, ctx->tab.blocks + first, sizeof(rbuf_u8 *) * block_num);
+        alloc_ctx->tab.phase = (ctx->tab.phase + first) % ctx->conf.slab_block_num;
+        alloc_ctx->cache.block_num = block_num;
+        alloc_ctx->cache.head_offs = rbuf_block_offs(ctx, offs);
+        alloc_ctx->cache.buff_cap = rbuf_block_cap(alloc_ctx, block_num);
+        alloc_ctx->cache.shared = true;
+        alloc_ctx->cache.block_align = ctx->cache.block_align;
+
+        /* the blocks come with their CRC-32C, but the hashed
+           bytes never go past the end of the buffer. */
+        if (RBUF_IS_SUMMED(ctx)) {
+            memcpy(rbuf_sum_of(alloc_ctx, 0), rbuf_sum_of(ctx, first), sizeof(rbuf_sum) * block_num);
+            rbuf_sum_drop(alloc_ctx, size, 1);
+        }
+
+        rbuf_size_update(alloc_ctx, size);
+
+        /* the last block of the buffer may be shared now. */
+        ctx->cache.shared = true;
+        rbuf_tail_update(ctx);
+    }
+
+    *slice = alloc_ctx;
+
+    return RBUF_OK;
+}
+
+/**
+ * @brief create a resizable buffer holding the same data as another one,
+ *        the blocks are shared instead of copied.
+ * 
+ * @param ctx context pointer, it is in the "RBUF_FLAG_SHARED" mode.
+ * @param clone the address of the context pointer of the new buffer,
+ *              it is deleted by rbuf_del().
+*/
+rbuf_res rbuf_clone(rbuf_ctx *ctx, rbuf_ctx **clone) {
+    RBUF_ASSERT(ctx != NULL);
+
+    return rbuf_slice(ctx, 0, ctx->cache.buff_size, clone);
+}
+
+/**
+ * @brief copy a range of one resizable buffer into another one,
+ *        the destination range must lie inside its blocks.
+ * 
+ * @param dst destination context pointer.
+ * @param dst_offs offset in the destination buffer.
+ * @param src source context pointer.
+ * @param src_offs offset in the source buffer.
+ * @param size size of the range.
+*/
+static rbuf_res rbuf_range_copy(rbuf_ctx *dst, rbuf_u64 dst_offs, rbuf_ctx *src, rbuf_u64 src_offs, rbuf_u64 size) {
+    rbuf_u32 block_idx;
+    rbuf_u32 block_offs;
+    rbuf_u32 curt_size;
+    rbuf_res res;
+
+    block_idx = (rbuf_u32)rbuf_block_idx(src, src_offs);
+    block_offs = rbuf_block_offs(src, src_offs);
+    while (size != 0) {
+        curt_size = rbuf_block_size(src, block_idx) - block_offs;
+        if (curt_size > size) {
+            curt_size = (rbuf_u32)size;
+        }
+
+        res = rbuf_copy_from64(dst, src->tab.blocks[block_idx] + block_offs, dst_offs, curt_size);
+        if (res != RBUF_OK) {
+            return res;
+        }
+
+        dst_offs += curt_size;
+        size -= curt_size;
+        block_idx++;
+        block_offs = 0;
+    }
+
+    return RBUF_OK;
+}
+
 /**
- * @brief create a resizable buffer.
+ * @brief hand all the blocks of a resizable buffer over to the end of another
+ *        one, leaving the source empty.
  * 
- * @param ctx the address of the context pointer.
- * @param conf configuration pointer.
+ * @param dst destination context pointer, its table has room for the blocks.
+ * @param src source context pointer.
 */
-rbuf_res rbuf_new(rbuf_ctx **ctx, rbuf_conf *conf) {
-    rbuf_ctx *alloc_ctx;
-    bque_ctx *mod_bque_ctx;
-    bque_conf mod_bque_conf;
-    bque_res mod_bque_res;
-
-    RBUF_ASSERT(ctx != NULL);
+static void rbuf_block_take(rbuf_ctx *dst, rbuf_ctx *src) {
+    rbuf_u64 size;
 
-    mod_bque_conf.buff_num_max = 0;
-    mod_bque_conf.buff_size_max = 0;
-    mod_bque_res = bque_new(&mod_bque_ctx, &mod_bque_conf);
-    if (mod_bque_res != BQUE_OK) {
-        if (mod_bque_res == BQUE_ERR_NO_MEM) {
-            return RBUF_ERR_NO_MEM;
-        } else {
-            return RBUF_ERR;
-        }
+    if (dst->cache.block_num == 0) {
+        dst->cache.head_offs = src->cache.head_offs;
     }
 
-    alloc_ctx = (rbuf_ctx *)malloc(sizeof(rbuf_ctx));
-    if (alloc_ctx == NULL) {
-        bque_del(mod_bque_ctx);
+    memcpy(dst->tab.blocks + dst->cache.block_num, src->tab.blocks,
+           sizeof(rbuf_u8 *) * src->cache.block_num);
 
-        return RBUF_ERR_NO_MEM;
+    /* both have the same flags, so both keep the CRC-32C or neither. */
+    if (RBUF_IS_SUMMED(dst)) {
+        memcpy(rbuf_sum_of(dst, dst->cache.block_num), rbuf_sum_of(src, 0),
+               sizeof(rbuf_sum) * src->cache.block_num);
     }
-    memset(alloc_ctx, 0, sizeof(rbuf_ctx));
 
-    alloc_ctx->bque = mod_bque_ctx;
-    if (conf != NULL) {
-        alloc_ctx->conf.block_size = conf->block_size;
-        alloc_ctx->conf.size_max = conf->size_max;
-    } else {
-        alloc_ctx->conf.block_size = RBUF_DEF_BLOCK_SIZE;
-        alloc_ctx->conf.size_max = RBUF_DEF_SIZE_MAX;
+    dst->cache.block_num += src->cache.block_num;
+    dst->cache.buff_cap = rbuf_block_cap(dst, dst->cache.block_num);
+    dst->cache.shared = dst->cache.shared || src->cache.shared;
+    if (dst->cache.block_align == 0 ||
+        (src->cache.block_align != 0 && src->cache.block_align < dst->cache.block_align)) {
+        dst->cache.block_align = src->cache.block_align;
     }
 
-    *ctx = alloc_ctx;
+#ifdef RBUF_STATS
+    if (dst->stats.buff_cap_peak < dst->cache.buff_cap) {
+        dst->stats.buff_cap_peak = dst->cache.buff_cap;
+    }
+#endif
 
-    return RBUF_OK;
+    size = src->cache.buff_size;
+
+    src->cache.block_num = 0;
+    src->cache.buff_cap = 0;
+    src->lin.size = 0;
+    rbuf_head_reset(src);
+    rbuf_size_update(src, 0);
+
+    rbuf_size_update(dst, dst->cache.buff_size + size);
 }
 
 /**
- * @brief delete the resizable buffer.
+ * @brief move all the data of a resizable buffer to the end of another one,
+ *        leaving the source empty.
  * 
- * @param ctx context pointer.
+ * @param dst destination context pointer.
+ * @param src source context pointer.
 */
-rbuf_res rbuf_del(rbuf_ctx *ctx) {
-    RBUF_ASSERT(ctx != NULL);
+rbuf_res rbuf_splice(rbuf_ctx *dst, rbuf_ctx *src) {
+    rbuf_u64 dst_size;
+    rbuf_u64 src_size;
+    rbuf_u32 block_size;
+    rbuf_u32 end_offs;
+    rbuf_u32 head_size;
+    bool movable;
+    rbuf_res res;
+
+    RBUF_ASSERT(dst != NULL);
+    RBUF_ASSERT(src != NULL);
 
-    bque_del(ctx->bque);
+    if (RBUF_IS_SPSC(dst) ||
+        RBUF_IS_SPSC(src) ||
+        dst == src) {
+        return RBUF_ERR;
+    }
 
-    free(ctx);
+    dst_size = dst->cache.buff_size;
+    src_size = src->cache.buff_size;
+    if (src_size > RBUF_SIZE_LIMIT - dst_size ||
+        (dst->conf.size_max != 0 &&
+         src_size > dst->conf.size_max - dst_size)) {
+        return RBUF_ERR_BAD_SIZE;
+    }
 
-    return RBUF_OK;
+    if (src_size == 0) {
+        return RBUF_OK;
+    }
+
+    /* the concurrent copying has to leave the buffer size as it is. */
+    if (RBUF_IS_CONCURRENT(dst)) {
+        return RBUF_ERR_BAD_SIZE;
+    }
+
+    /* the blocks can change hands when they are alike, come from
+       the same allocator, and are released the same way. */
+    block_size = dst->conf.block_size;
+    movable = rbuf_block_movable(dst) &&
+              rbuf_block_movable(src) &&
+              src->conf.block_size == block_size &&
+              src->conf.flags == dst->conf.flags &&
+              src->conf.block_align == dst->conf.block_align &&
+              src->pool.base == NULL &&
+              dst->pool.base == NULL &&
+              src->conf.mem.alloc == dst->conf.mem.alloc &&
+              src->conf.mem.free == dst->conf.mem.free &&
+              src->conf.mem.user == dst->conf.mem.user &&
+              (rbuf_u64)src->cache.block_num + dst->cache.block_num < UINT32_MAX;
+    if (movable) {
+
+        /* a block past the end would leave a hole. */
+        if (dst->cache.buff_cap - dst_size >= block_size ||
+            dst_size == 0) {
+            rbuf_resize64(dst, dst_size);
+        }
+
+        end_offs = rbuf_block_offs(dst, dst_size);
+        if (end_offs == src->cache.head_offs) {
+            res = rbuf_tab_reserve(dst, dst->cache.block_num + src->cache.block_num);
+            if (res != RBUF_OK) {
+                return res;
+            }
+
+            /* the boundary block is merged into the last block of the destination. */
+            if (end_offs != 0) {
+                res = rbuf_cow(dst, dst_size, 1);
+                if (res != RBUF_OK) {
+                    return res;
+                }
+
+                head_size = block_size - end_offs;
+                if (head_size > src_size) {
+                    head_size = (rbuf_u32)src_size;
+                }
+
+                memcpy(dst->tab.blocks[dst->cache.block_num - 1] + end_offs,
+                       src->tab.blocks[0] + end_offs, head_size);
+                rbuf_size_update(dst, dst_size + head_size);
+
+                res = rbuf_consume(src, head_size);
+                if (res != RBUF_OK ||
+                    src->cache.buff_size == 0) {
+                    return res;
+                }
+            }
+
+            rbuf_block_take(dst, src);
+
+            return RBUF_OK;
+        }
+
+        /* the destination is the smaller one, so it is the one copied. */
+        if (dst_size < src_size) {
+            res = rbuf_tab_reserve(dst, src->cache.block_num +
+                                        (rbuf_u32)((dst_size + block_size - 1) / block_size));
+            if (res != RBUF_OK) {
+                return res;
+            }
+
+            res = rbuf_cow(src, 0, 1);
+            if (res != RBUF_OK) {
+                return res;
+            }
+
+            res = rbuf_head_grow(src, dst_size);
+            if (res != RBUF_OK) {
+                return res;
+            }
+
+            src->lin.size = 0;
+            res = rbuf_range_copy(src, 0, dst, 0, dst_size);
+            if (res != RBUF_OK) {
+                return res;
+            }
+
+            rbuf_resize64(dst, 0);
+            rbuf_block_take(dst, src);
+
+            return RBUF_OK;
+        }
+    }
+
+    res = rbuf_cow(dst, dst_size, src_size);
+    if (res != RBUF_OK) {
+        return res;
+    }
+
+    res = rbuf_resize64(dst, dst_size + src_size);
+    if (res != RBUF_OK) {
+        return res;
+    }
+
+    res = rbuf_range_copy(dst, dst_size, src, 0, src_size);
+    if (res != RBUF_OK) {
+        return res;
+    }
+
+    return rbuf_resize64(src, 0);
 }
 
 /**
- * @brief get the status of the resizable buffer.
+ * @brief get the CRC-32C of the data in the resizable buffer.
  * 
  * @param ctx context pointer.
- * @param stat status pointer.
+ * @param crc the address of the CRC-32C, 0 for an empty buffer.
 */
-rbuf_res rbuf_status(rbuf_ctx *ctx, rbuf_stat *stat) {
+rbuf_res rbuf_checksum(rbuf_ctx *ctx, rbuf_u32 *crc) {
+    rbuf_sum *sum;
+    rbuf_u64 rest_size;
+    rbuf_u32 from;
+    rbuf_u32 to;
+    rbuf_u32 shift;
+    rbuf_u32 shift_size;
+    rbuf_u32 total;
+
     RBUF_ASSERT(ctx != NULL);
-    RBUF_ASSERT(stat != NULL);
+    RBUF_ASSERT(crc != NULL);
 
-    stat->block_num = ctx->cache.block_num;
-    stat->buff_size = ctx->cache.buff_size;
+    if (RBUF_IS_SPSC(ctx)) {
+        return RBUF_ERR;
+    }
+
+    if (!RBUF_IS_SUMMED(ctx)) {
+        *crc = rbuf_range_crc32c(ctx, 0, 0, ctx->cache.buff_size);
+
+        return RBUF_OK;
+    }
+
+    total = 0;
+    shift = 0;
+    shift_size = 0;
+    from = ctx->cache.head_offs;
+    rest_size = ctx->cache.buff_size;
+    for (rbuf_u32 i = 0; rest_size != 0; i++) {
+        to = rbuf_block_size(ctx, i);
+        if (to - from > rest_size) {
+            to = from + (rbuf_u32)rest_size;
+        }
+
+        /* hash the block again when the hashed bytes aren't all its
+           data, or only hash the data after them. */
+        sum = rbuf_sum_of(ctx, i);
+        if (sum->from != from ||
+            sum->to > to) {
+            sum->crc = 0;
+            sum->from = from;
+            sum->to = from;
+        }
+
+        if (sum->to != to) {
+            sum->crc = rbuf_crc32c_update(sum->crc, ctx->tab.blocks[i] + sum->to, to - sum->to);
+            sum->to = to;
+        }
+
+        /* nothing to shift before the first block, and the blocks
+           mostly share one size, so the shift is rarely made. */
+        if (i == 0) {
+            total = sum->crc;
+        } else {
+            if (to - from != shift_size) {
+                shift_size = to - from;
+                shift = rbuf_crc32c_shift(shift_size);
+            }
+
+            total = rbuf_crc32c_mul(shift, total) ^ sum->crc;
+        }
+
+        rest_size -= to - from;
+        from = 0;
+    }
+
+    *crc = total;
 
     return RBUF_OK;
 }
 
+#ifdef RBUF_HAS_SYS_UIO
+
 /**
- * @brief resize the buffer size of the resizable buffer.
+ * @brief read data from a file descriptor to the end of the resizable buffer.
  * 
  * @param ctx context pointer.
- * @param size the new size.
+ * @param fd file descriptor to read from.
+ * @param size maximum reading size.
+ * @param done the address of the read size, it is 0 at the end of the file.
+ *             when RBUF_ERR is returned, errno tells why readv() failed.
 */
-rbuf_res rbuf_resize(rbuf_ctx *ctx, rbuf_u32 size) {
-    rbuf_u32 new_block_num;
-    rbuf_u32 block_num_diff;
-    rbuf_u32 new_block_num_quotient;
-    rbuf_u32 new_block_num_remainder;
-    bque_res mod_bque_res;
+rbuf_res rbuf_read_fd(rbuf_ctx *ctx, int fd, rbuf_u32 size, rbuf_u32 *done) {
+    rbuf_iovec iov[RBUF_IOV_NUM];
+    int iovcnt;
+    rbuf_u64 rest_size;
+    rbuf_u64 reach_size;
+    rbuf_u64 new_block_num;
+    ssize_t read_size;
+    rbuf_res res;
 
     RBUF_ASSERT(ctx != NULL);
+    RBUF_ASSERT(done != NULL);
 
-    /* check whether the size is too large. */
+    *done = 0;
+
+    if (RBUF_IS_SPSC(ctx)) {
+        return RBUF_ERR;
+    }
+
+    /* the concurrent copying has to leave the buffer size as it is. */
+    if (RBUF_IS_CONCURRENT(ctx)) {
+        return RBUF_ERR_BAD_SIZE;
+    }
+
+    rest_size = size;
     if (ctx->conf.size_max != 0 &&
-        size > ctx->conf.size_max) {
+        rest_size > ctx->conf.size_max - ctx->cache.buff_size) {
+        rest_size = ctx->conf.size_max - ctx->cache.buff_size;
+    }
+
+    if (rest_size > RBUF_SIZE_LIMIT - ctx->cache.buff_size) {
+        rest_size = RBUF_SIZE_LIMIT - ctx->cache.buff_size;
+    }
+
+    if (rest_size == 0) {
+        return (size == 0) ? RBUF_OK : RBUF_ERR_BAD_SIZE;
+    }
+
+    /* grow only the blocks one readv() can fill. */
+    reach_size = rbuf_block_reach(ctx, ctx->cache.buff_size, RBUF_IOV_NUM);
+    if (rest_size > reach_size) {
+        rest_size = reach_size;
+    }
+
+    res = rbuf_inline_fit(ctx, ctx->cache.buff_size + rest_size);
+    if (res != RBUF_OK) {
+        return res;
+    }
+
+    res = rbuf_cow(ctx, ctx->cache.buff_size, rest_size);
+    if (res != RBUF_OK) {
+        return res;
+    }
+
+    new_block_num = rbuf_block_num(ctx, ctx->cache.buff_size + rest_size);
+    if (new_block_num > UINT32_MAX) {
         return RBUF_ERR_BAD_SIZE;
     }
 
-    new_block_num_quotient = size / ctx->conf.block_size;
-    new_block_num_remainder = size % ctx->conf.block_size;
-    new_block_num = new_block_num_quotient + ((new_block_num_remainder != 0) ? 1 : 0);
     if (new_block_num > ctx->cache.block_num) {
-        block_num_diff = new_block_num - ctx->cache.block_num;
-        for (rbuf_u32 i = 0; i < block_num_diff; i++) {
-            mod_bque_res = bque_enqueue(ctx->bque, NULL, ctx->conf.block_size);
-            if (mod_bque_res != BQUE_OK) {
-                if (mod_bque_res == BQUE_ERR_NO_MEM) {
-                    return RBUF_ERR_NO_MEM;
-                } else {
-                    return RBUF_ERR;
-                }
-            }
-        }
-        ctx->cache.block_num = new_block_num;
-        ctx->cache.buff_cap = ctx->conf.block_size * new_block_num;
-    } else if (new_block_num < ctx->cache.block_num) {
-        block_num_diff = ctx->cache.block_num - new_block_num;
-        for (rbuf_u32 i = 0; i < block_num_diff; i++) {
-            mod_bque_res = bque_forfeit(ctx->bque, NULL, NULL);
-            if (mod_bque_res != BQUE_OK) {
-                return RBUF_ERR;
-            }
+        res = rbuf_block_grow(ctx, (rbuf_u32)new_block_num);
+        if (res != RBUF_OK) {
+            return res;
         }
-
-        ctx->cache.block_num = new_block_num;
-        ctx->cache.buff_cap = ctx->conf.block_size * new_block_num;
     }
 
-    /* update the buffer size of the whole resizable buffer. */
-    ctx->cache.buff_size = size;
+    iovcnt = RBUF_IOV_NUM;
+    rbuf_iov_fill(ctx, ctx->cache.buff_size, rest_size, iov, &iovcnt);
 
-    /* update the buffer size of the last block. */
-    if (new_block_num_quotient != 0 &&
-        new_block_num_remainder == 0) {
-        ctx->cache.last_block_buff_size = ctx->conf.block_size;
-    } else {
-        ctx->cache.last_block_buff_size = new_block_num_remainder;
+    read_size = readv(fd, iov, iovcnt);
+    if (read_size < 0) {
+        return RBUF_ERR;
     }
 
+    rbuf_sum_add_range(ctx, ctx->cache.buff_size, (rbuf_u64)read_size);
+    rbuf_size_update(ctx, ctx->cache.buff_size + (rbuf_u64)read_size);
+    *done = (rbuf_u32)read_size;
+
     return RBUF_OK;
 }
 
 /**
- * @brief copy external data into the resizable buffer.
+ * @brief write and consume data from the front of the resizable buffer to a
+ *        file descriptor.
  * 
  * @param ctx context pointer.
- * @param buff external buffer pointer.
- * @param offs offset indicating where to start copying in the resizable buffer.
- * @param size data copying size;
+ * @param fd file descriptor to write to.
+ * @param size maximum writing size.
+ * @param done the address of the written size.
+ *             when RBUF_ERR is returned, errno tells why the writing failed.
 */
-rbuf_res rbuf_copy_from(rbuf_ctx *ctx, const void *buff, rbuf_u32 offs, rbuf_u32 size) {
-    rbuf_u32 new_size;
-    rbuf_u32 block_offs;
-    rbuf_u32 starting_block_idx;
-    rbuf_u32 ending_block_idx;
-    bque_buff mod_bque_buff;
-    bque_res mod_bque_res;
-    rbuf_res res;
+rbuf_res rbuf_write_fd(rbuf_ctx *ctx, int fd, rbuf_u32 size, rbuf_u32 *done) {
+    rbuf_iovec iov[RBUF_IOV_NUM];
+    int iovcnt;
+    ssize_t write_size;
+#ifdef RBUF_HAS_SENDFILE
+    off_t file_offs;
+#endif
 
     RBUF_ASSERT(ctx != NULL);
-    RBUF_ASSERT(buff != NULL);
+    RBUF_ASSERT(done != NULL);
 
-    new_size = offs + size;
+    *done = 0;
 
-    /* if the new buffer size is greater than
-       the buffer size, resize the buffer. */
-    if (new_size > ctx->cache.buff_size) {
-        res = rbuf_resize(ctx, new_size);
-        if (res != RBUF_OK) {
-            return res;
-        }
+    if (RBUF_IS_SPSC(ctx)) {
+        return RBUF_ERR;
     }
 
-    starting_block_idx = offs / ctx->conf.block_size;
-    ending_block_idx = new_size / ctx->conf.block_size -
-                       ((new_size % ctx->conf.block_size == 0) ? 1 : 0);
-    if (starting_block_idx == ending_block_idx) {
-        mod_bque_res = bque_item(ctx->bque, starting_block_idx, &mod_bque_buff);
-        if (mod_bque_res != BQUE_OK) {
-            return RBUF_ERR;
-        }
+    if (size > ctx->cache.buff_size) {
+        return RBUF_ERR_BAD_SIZE;
+    }
 
-        block_offs = offs % ctx->conf.block_size;
-        memcpy(mod_bque_buff.ptr + block_offs, buff, size);
-    } else {
-        rbuf_u32 buff_offs;
-        rbuf_u32 rest_size;
-        rbuf_u32 curt_size;
+    if (size == 0) {
+        return RBUF_OK;
+    }
+
+#ifdef RBUF_HAS_SENDFILE
+
+    /* the data sits in the backing file in order, so
+       the kernel can take it from the page cache. */
+    if (RBUF_IS_MMAP(ctx) &&
+        ctx->map.fd >= 0) {
+        file_offs = (off_t)((rbuf_u64)ctx->conf.block_size * rbuf_map_first(ctx) +
+                            ctx->cache.head_offs);
+        write_size = sendfile(fd, ctx->map.fd, &file_offs, size);
+    } else
+#endif
+    {
+        iovcnt = RBUF_IOV_NUM;
+        rbuf_iov_fill(ctx, 0, size, iov, &iovcnt);
+
+        write_size = writev(fd, iov, iovcnt);
+    }
+
+    if (write_size < 0) {
+        return RBUF_ERR;
+    }
+
+    *done = (rbuf_u32)write_size;
+
+    return rbuf_consume(ctx, (rbuf_u32)write_size);
+}
+
+/**
+ * @brief store a value in little endian.
+ * 
+ * @param dst destination pointer.
+ * @param val value.
+ * @param size value size in bytes.
+*/
+static void rbuf_put_le(rbuf_u8 *dst, rbuf_u64 val, rbuf_u32 size) {
+    for (rbuf_u32 i = 0; i < size; i++) {
+        dst[i] = (rbuf_u8)(val >> (8 * i));
+    }
+}
+
+/**
+ * @brief load a value stored in little endian.
+ * 
+ * @param src source pointer.
+ * @param size value size in bytes.
+*/
+static rbuf_u64 rbuf_get_le(const rbuf_u8 *src, rbuf_u32 size) {
+    rbuf_u64 val;
+
+    val = 0;
+    for (rbuf_u32 i = 0; i < size; i++) {
+        val |= (rbuf_u64)src[i] << (8 * i);
+    }
+
+    return val;
+}
+
+/**
+ * @brief write the whole of a memory area to a file descriptor.
+ * 
+ * @param fd file descriptor to write to.
+ * @param buff memory pointer.
+ * @param size memory size.
+*/
+static rbuf_res rbuf_fd_write_all(int fd, const rbuf_u8 *buff, size_t size) {
+    ssize_t write_size;
+
+    while (size != 0) {
+        write_size = write(fd, buff, size);
+        if (write_size < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
 
-        mod_bque_res = bque_item(ctx->bque, starting_block_idx, &mod_bque_buff);
-        if (mod_bque_res != BQUE_OK) {
             return RBUF_ERR;
         }
 
-        block_offs = offs % ctx->conf.block_size;
-        curt_size = ctx->conf.block_size - block_offs;
-        memcpy(mod_bque_buff.ptr + block_offs, buff, curt_size);
+        buff += write_size;
+        size -= (size_t)write_size;
+    }
 
-        buff_offs = curt_size;
-        rest_size = size - curt_size;
+    return RBUF_OK;
+}
 
-        for (bque_u32 i = starting_block_idx + 1; i < ending_block_idx + 1; i++) {
-            mod_bque_res = bque_item(ctx->bque, (bque_s32)i, &mod_bque_buff);
-            if (mod_bque_res != BQUE_OK) {
-                return RBUF_ERR;
-            }
+/**
+ * @brief read the whole of a memory area from a file descriptor.
+ * 
+ * @param fd file descriptor to read from.
+ * @param buff memory pointer.
+ * @param size memory size.
+*/
+static rbuf_res rbuf_fd_read_all(int fd, rbuf_u8 *buff, size_t size) {
+    ssize_t read_size;
 
-            if (rest_size > ctx->conf.block_size) {
-                curt_size = ctx->conf.block_size;
-            } else {
-                curt_size = rest_size;
+    while (size != 0) {
+        read_size = read(fd, buff, size);
+        if (read_size < 0) {
+            if (errno == EINTR) {
+                continue;
             }
 
-            memcpy(mod_bque_buff.ptr, (rbuf_u8 *)buff + buff_offs, curt_size);
+            return RBUF_ERR;
+        }
 
-            buff_offs += curt_size;
-            rest_size -= curt_size;
+        /* the snapshot was cut short. */
+        if (read_size == 0) {
+            return RBUF_ERR_BAD_SIZE;
         }
+
+        buff += read_size;
+        size -= (size_t)read_size;
     }
 
     return RBUF_OK;
 }
 
 /**
- * @brief append external data to the end of the resizable buffer.
+ * @brief write a snapshot of the resizable buffer to a file descriptor.
+ * 
+ *        the snapshot is a 32-byte little-endian header and the data:
+ *        - 0: "RBUF"
+ *        - 4: version, 1
+ *        - 8: block size of the buffer, only for information
+ *        - 12: CRC-32C of the data
+ *        - 16: data size, 64 bits
+ *        - 24: CRC-32C of the 24 bytes above
+ *        - 28: 0
  * 
  * @param ctx context pointer.
- * @param buff external buffer pointer.
- * @param size data appending size;
+ * @param fd file descriptor to write to.
+ *           when RBUF_ERR is returned, errno tells why the writing failed.
 */
-rbuf_res rbuf_append(rbuf_ctx *ctx, const void *buff, rbuf_u32 size) {
+rbuf_res rbuf_save(rbuf_ctx *ctx, int fd) {
+    rbuf_u8 hdr[RBUF_SNAP_HDR_SIZE];
+    rbuf_iovec iov[RBUF_IOV_NUM];
+    int iovcnt;
+    rbuf_u64 offs;
+    rbuf_u32 crc;
+    ssize_t write_size;
     rbuf_res res;
 
     RBUF_ASSERT(ctx != NULL);
-    RBUF_ASSERT(buff != NULL);
 
-    res = rbuf_copy_from(ctx, buff, ctx->cache.buff_size, size);
-    return res;
+    res = rbuf_checksum(ctx, &crc);
+    if (res != RBUF_OK) {
+        return res;
+    }
+
+    memset(hdr, 0, sizeof(hdr));
+    memcpy(hdr, RBUF_SNAP_MAGIC, 4);
+    rbuf_put_le(hdr + 4, RBUF_SNAP_VERSION, 4);
+    rbuf_put_le(hdr + 8, ctx->conf.block_size, 4);
+    rbuf_put_le(hdr + 12, crc, 4);
+    rbuf_put_le(hdr + 16, ctx->cache.buff_size, 8);
+    rbuf_put_le(hdr + 24, rbuf_crc32c_update(0, hdr, 24), 4);
+
+    res = rbuf_fd_write_all(fd, hdr, sizeof(hdr));
+    if (res != RBUF_OK) {
+        return res;
+    }
+
+    offs = 0;
+    while (offs != ctx->cache.buff_size) {
+        iovcnt = RBUF_IOV_NUM;
+        rbuf_iov_fill(ctx, offs, ctx->cache.buff_size - offs, iov, &iovcnt);
+
+        write_size = writev(fd, iov, iovcnt);
+        if (write_size < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            return RBUF_ERR;
+        }
+
+        offs += (rbuf_u64)write_size;
+    }
+
+    return RBUF_OK;
 }
 
 /**
- * @brief copy data in the resizable buffer into the external buffer.
+ * @brief replace the data of the resizable buffer with a snapshot written by
+ *        rbuf_save(), a broken snapshot leaves the buffer as it was.
  * 
  * @param ctx context pointer.
- * @param buff external buffer pointer.
- * @param offs offset indicating where to start copying in the resizable buffer.
- * @param size data copying size;
+ * @param fd file descriptor to read from.
+ * @return RBUF_ERR_BAD_SIZE for a snapshot cut short or too large for the
+ *         buffer, RBUF_ERR for a bad header or data, or a failed reading,
+ *         errno tells why the reading failed then.
 */
-rbuf_res rbuf_copy_to(rbuf_ctx *ctx, void *buff, rbuf_u32 offs, rbuf_u32 size) {
-    rbuf_u32 ending_byte_no;
-    rbuf_u32 block_offs;
-    rbuf_u32 starting_block_idx;
-    rbuf_u32 ending_block_idx;
-    bque_buff mod_bque_buff;
-    bque_res mod_bque_res;
+rbuf_res rbuf_load(rbuf_ctx *ctx, int fd) {
+    rbuf_u8 hdr[RBUF_SNAP_HDR_SIZE];
+    rbuf_iovec iov[RBUF_IOV_NUM];
+    int iovcnt;
+    rbuf_u64 old_size;
+    rbuf_u64 size_max;
+    rbuf_u64 grow_size;
+    rbuf_u64 size;
+    rbuf_u64 offs;
+    rbuf_u32 curt_size;
+    rbuf_u32 crc;
+    ssize_t read_size;
+    rbuf_res res;
 
     RBUF_ASSERT(ctx != NULL);
-    RBUF_ASSERT(buff != NULL);
 
-    if (offs > ctx->cache.buff_size) {
-        return RBUF_ERR_BAD_OFFS;
+    if (RBUF_IS_SPSC(ctx)) {
+        return RBUF_ERR;
     }
 
-    ending_byte_no = offs + size;
-    if (ending_byte_no > ctx->cache.buff_size) {
+    /* the concurrent copying has to leave the buffer size as it is. */
+    if (RBUF_IS_CONCURRENT(ctx)) {
         return RBUF_ERR_BAD_SIZE;
     }
 
-    starting_block_idx = offs / ctx->conf.block_size;
-    ending_block_idx = ending_byte_no / ctx->conf.block_size;
-    if (starting_block_idx == ending_block_idx) {
-        mod_bque_res = bque_item(ctx->bque, starting_block_idx, &mod_bque_buff);
-        if (mod_bque_res != BQUE_OK) {
-            return RBUF_ERR;
-        }
+    res = rbuf_fd_read_all(fd, hdr, sizeof(hdr));
+    if (res != RBUF_OK) {
+        return res;
+    }
 
-        block_offs = offs % ctx->conf.block_size;
-        memcpy(buff, mod_bque_buff.ptr + block_offs, size);
-    } else {
-        rbuf_u32 buff_offs;
-        rbuf_u32 rest_size;
-        rbuf_u32 curt_size;
+    if (memcmp(hdr, RBUF_SNAP_MAGIC, 4) != 0 ||
+        rbuf_get_le(hdr + 4, 4) != RBUF_SNAP_VERSION ||
+        rbuf_get_le(hdr + 24, 4) != rbuf_crc32c_update(0, hdr, 24)) {
+        return RBUF_ERR;
+    }
 
-        mod_bque_res = bque_item(ctx->bque, starting_block_idx, &mod_bque_buff);
-        if (mod_bque_res != BQUE_OK) {
-            return RBUF_ERR;
-        }
+    size = rbuf_get_le(hdr + 16, 8);
+    old_size = ctx->cache.buff_size;
+    if (size > RBUF_SIZE_LIMIT - old_size ||
+        (ctx->conf.size_max != 0 &&
+         size > ctx->conf.size_max)) {
+        return RBUF_ERR_BAD_SIZE;
+    }
 
-        block_offs = offs % ctx->conf.block_size;
-        curt_size = ctx->conf.block_size - block_offs;
-        memcpy(buff, mod_bque_buff.ptr + block_offs, curt_size);
+    /* the limit is for the data left at the end, the old data is
+       kept along with the snapshot until the snapshot is checked. */
+    size_max = ctx->conf.size_max;
+    ctx->conf.size_max = 0;
 
-        buff_offs = curt_size;
-        rest_size = size - curt_size;
+    /* the data is checked as it comes in, while it is still in the cache,
+       and the buffer only grows, by doubling, as far as the data came. */
+    crc = 0;
+    offs = 0;
+    grow_size = 0;
+    res = RBUF_OK;
+    while (offs != size) {
+        if (offs == grow_size) {
+            grow_size = (rbuf_u64)ctx->conf.block_size * RBUF_IOV_NUM;
+            if (grow_size < offs) {
+                grow_size = offs;
+            }
 
-        for (bque_u32 i = starting_block_idx + 1; i < ending_block_idx + 1; i++) {
-            mod_bque_res = bque_item(ctx->bque, (bque_s32)i, &mod_bque_buff);
-            if (mod_bque_res != BQUE_OK) {
-                return RBUF_ERR;
+            if (grow_size > size - offs) {
+                grow_size = size - offs;
             }
 
-            if (rest_size > ctx->conf.block_size) {
-                curt_size = ctx->conf.block_size;
-            } else {
-                curt_size = rest_size;
+            grow_size += offs;
+            res = rbuf_resize64(ctx, old_size + grow_size);
+            if (res != RBUF_OK) {
+                break;
+            }
+
+            /* readv() writes straight into the blocks, the last
+               old one may still be shared with another buffer. */
+            res = rbuf_cow(ctx, old_size + offs, grow_size - offs);
+            if (res != RBUF_OK) {
+                break;
             }
+        }
 
-            memcpy((rbuf_u8 *)buff + buff_offs, mod_bque_buff.ptr, curt_size);
+        iovcnt = RBUF_IOV_NUM;
+        rbuf_iov_fill(ctx, old_size + offs, grow_size - offs, iov, &iovcnt);
 
-            buff_offs += curt_size;
-            rest_size -= curt_size;
+        read_size = readv(fd, iov, iovcnt);
+        if (read_size <= 0) {
+            if (read_size < 0 &&
+                errno == EINTR) {
+                continue;
+            }
+
+            res = (read_size == 0) ? RBUF_ERR_BAD_SIZE : RBUF_ERR;
+            break;
         }
+
+        crc = rbuf_range_crc32c(ctx, crc, old_size + offs, (rbuf_u64)read_size);
+        offs += (rbuf_u64)read_size;
+    }
+
+    if (res == RBUF_OK &&
+        crc != (rbuf_u32)rbuf_get_le(hdr + 12, 4)) {
+        res = RBUF_ERR;
+    }
+
+    if (res != RBUF_OK) {
+        rbuf_resize64(ctx, old_size);
+        ctx->conf.size_max = size_max;
+
+        return res;
     }
 
+    /* the old data is only dropped from the front, so nothing moves. */
+    while (old_size != 0) {
+        curt_size = (old_size < UINT32_MAX) ? (rbuf_u32)old_size : UINT32_MAX;
+        rbuf_consume(ctx, curt_size);
+        old_size -= curt_size;
+    }
+
+    ctx->conf.size_max = size_max;
+
     return RBUF_OK;
 }
+
+#endif
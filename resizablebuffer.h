@@ -25,8 +25,17 @@
 #ifndef __RBUF_H__
 #define __RBUF_H__
 
+#include <stddef.h>
 #include <stdint.h>
 
+#if defined(__unix__) || defined(__APPLE__)
+
+#include <sys/uio.h>
+
+#define RBUF_HAS_SYS_UIO
+
+#endif
+
 #ifdef RBUF_DEBUG
 
 #include <stdarg.h>
@@ -63,6 +72,9 @@ enum _rbuf_res {
 
     /* invalid size. */
     RBUF_ERR_BAD_SIZE   = -4,
+
+    /* the searched data isn't found. */
+    RBUF_ERR_NOT_FOUND  = -5,
 };
 
 #ifdef RBUF_DEBUG
@@ -88,33 +100,309 @@ typedef rbuf_s32            rbuf_res;
 
 #endif
 
-/* configuration of the resizable buffer. */
+/* size of the block kept inside the context, 0 disables it,
+   it must be the same for the library and its users. */
+#ifndef RBUF_INLINE_SIZE
+#define RBUF_INLINE_SIZE    128
+#endif
+
+/* size of the memory rbuf_init() needs for a context. */
+#define RBUF_CTX_SIZE       (512 + RBUF_INLINE_SIZE)
+
+/* "map_fd" of the anonymous memory, rbuf_conf_init() sets it. */
+#define RBUF_MAP_ANON       (-1)
+
+/* flags of the resizable buffer. */
+enum _rbuf_flag {
+
+    /* single-producer/single-consumer ring, one thread appends
+       while another one copies out and consumes, without locks. */
+    RBUF_FLAG_SPSC      = 0x01,
+
+    /* the blocks live in one memory mapping, of "map_fd" or anonymous,
+       which moves as it grows, the file holds the data on rbuf_del(). */
+    RBUF_FLAG_MMAP      = 0x02,
+
+    /* rbuf_clone() and rbuf_slice() share the slab chunks, which are
+       copied on writing, the pointers into shared blocks are read-only. */
+    RBUF_FLAG_SHARED    = 0x04,
+
+    /* several threads may copy into and out of disjoint ranges at once,
+       without locks, nothing grows the buffer in this mode. */
+    RBUF_FLAG_CONCURRENT = 0x08,
+
+    /* the freed slab chunks are recycled through per-thread caches,
+       rbuf_recycle_trim() frees them. */
+    RBUF_FLAG_RECYCLE   = 0x10,
+
+    /* the slab chunks of 2 MiB or more are aligned
+       to huge pages and advised to be backed by them. */
+    RBUF_FLAG_HUGE_PAGE = 0x20,
+
+    /* the CRC-32C of each block is kept as the data is copied in,
+       so rbuf_checksum() only hashes the blocks written otherwise. */
+    RBUF_FLAG_CHECKSUM  = 0x40,
+};
+
+/* memory allocator, NULL callbacks fall back to malloc(), realloc() and free(). */
+typedef struct _rbuf_mem {
+    void *(*alloc)(void *user, size_t size);
+    void *(*realloc)(void *user, void *ptr, size_t size);
+    void (*free)(void *user, void *ptr);
+
+    /* user pointer passed to each callback. */
+    void *user;
+} rbuf_mem;
+
+/* configuration of the resizable buffer, "size_max" was 32-bit and the
+   fields after it are new since the first version, they keep its
+   behaviour at 0, so zero them or call rbuf_conf_init() first. */
 typedef struct _rbuf_conf {
     rbuf_u32 block_size;
-    rbuf_u32 size_max;
+    rbuf_u64 size_max;
+
+    /* number of blocks in one slab chunk, 0 or 1 for none. */
+    rbuf_u32 slab_block_num;
+
+    /* allocator of the context and its blocks. */
+    rbuf_mem mem;
+
+    /* bitwise OR of the "RBUF_FLAG_*" flags. */
+    rbuf_u32 flags;
+
+    /* spare slab chunks kept on shrinking, trimmed to "spare_low"
+       once there are "spare_high" of them. */
+    rbuf_u32 spare_low;
+    rbuf_u32 spare_high;
+
+    /* file of "RBUF_FLAG_MMAP", not positive for anonymous memory. */
+    int map_fd;
+
+    /* largest block size, the block sizes double up to it as
+       the buffer grows, 0 keeps all at "block_size". */
+    rbuf_u32 block_size_max;
+
+    /* memory used for the blocks before any allocation, NULL for none. */
+    void *pool;
+    size_t pool_size;
+
+    /* alignment of each block, a power of two, 0 for the allocator's. */
+    rbuf_u32 block_align;
 } rbuf_conf;
 
 /* status of the resizable buffer. */
 typedef struct _rbuf_stat {
     rbuf_u32 block_num;
     rbuf_u32 buff_size;
+
+    /* alignment of all the blocks, 0 means there is no block. */
+    rbuf_u32 block_align;
 } rbuf_stat;
 
+/* status of the resizable buffer, with the 64-bit buffer size. */
+typedef struct _rbuf_stat64 {
+    rbuf_u32 block_num;
+    rbuf_u64 buff_size;
+    rbuf_u32 block_align;
+} rbuf_stat64;
+
+#ifdef RBUF_STATS
+
+/* counters of the resizable buffer, they are only kept when RBUF_STATS
+   is defined, both for the library and its users. */
+typedef struct _rbuf_counters {
+
+    /* bytes copied into and out of the blocks. */
+    rbuf_u64 copy_in_size;
+    rbuf_u64 copy_out_size;
+
+    /* copying calls, and the ones which spanned more than one block,
+       the appending which doesn't fit into the last block counts as a
+       copying into the buffer. */
+    rbuf_u64 copy_from_num;
+    rbuf_u64 copy_from_span_num;
+    rbuf_u64 copy_to_num;
+    rbuf_u64 copy_to_span_num;
+
+    /* blocks added to and released from the buffer. */
+    rbuf_u64 block_alloc_num;
+    rbuf_u64 block_free_num;
+
+    /* resizing calls, and the largest capacity ever reached. */
+    rbuf_u64 resize_num;
+    rbuf_u64 buff_cap_peak;
+
+    /* failed allocations of the blocks and the bookkeeping memory. */
+    rbuf_u64 alloc_fail_num;
+} rbuf_counters;
+
+/* status of the resizable buffer, along with its counters. */
+typedef struct _rbuf_stat_ext {
+    rbuf_u32 block_num;
+    rbuf_u64 buff_size;
+    rbuf_u64 buff_cap;
+    rbuf_u32 block_align;
+    rbuf_counters counters;
+} rbuf_stat_ext;
+
+#endif
+
+/* scatter/gather element pointing into the blocks of the resizable buffer,
+   it is the "struct iovec" of the platform when there is one, so an array
+   of them can be handed to readv() or writev() directly. */
+#ifdef RBUF_HAS_SYS_UIO
+
+typedef struct iovec        rbuf_iovec;
+
+#else
+
+typedef struct _rbuf_iovec {
+    void *iov_base;
+    size_t iov_len;
+} rbuf_iovec;
+
+#endif
+
+/* range of the resizable buffer along with the external buffer it is
+   copied from or to, used by the batched copying. */
+typedef struct _rbuf_range {
+    rbuf_u64 offs;
+    rbuf_u64 size;
+    void *buff;
+} rbuf_range;
+
+/* executor of rbuf_copy_from_parallel(), it calls "task(arg, idx)" once for
+   every "idx" below "num", on whatever threads it has, and returns once all
+   the calls returned, "user" is the pointer given along with it. */
+typedef void (*rbuf_exec)(void *user, void (*task)(void *arg, rbuf_u32 idx), void *arg, rbuf_u32 num);
+
 /* context of the resizable buffer. */
 typedef struct _rbuf_ctx    rbuf_ctx;
 
+/* cursor reading the resizable buffer in sequence, set up by
+   rbuf_cursor_init(), it remembers the block of its position, so the
+   reading goes on from there without resolving the offset again.
+   it is left as is while the buffer is only read, after the buffer is
+   modified it is set again by rbuf_cursor_seek(). */
+typedef struct _rbuf_cursor {
+    rbuf_ctx *ctx;
+
+    /* position in the resizable buffer. */
+    rbuf_u64 offs;
+
+    /* block of the position and the offset inside it, as the
+       position was set, the reading moves "ptr" instead. */
+    rbuf_u32 block_idx;
+    rbuf_u32 block_offs;
+
+    /* the position in memory, and the bytes from there to the end of its
+       block, "ptr" is NULL until a byte at the position is available. */
+    rbuf_u8 *ptr;
+    rbuf_u32 rest;
+} rbuf_cursor;
+
+/* memory of a context set up by rbuf_init(), on the stack or static,
+   the other members only give it the alignment of the context. */
+typedef union _rbuf_ctx_storage {
+    rbuf_u8 data[RBUF_CTX_SIZE];
+    rbuf_u64 align_u64;
+    void *align_ptr;
+} rbuf_ctx_storage;
+
+rbuf_res rbuf_conf_init(rbuf_conf *conf);
+
 rbuf_res rbuf_new(rbuf_ctx **ctx, rbuf_conf *conf);
 
 rbuf_res rbuf_del(rbuf_ctx *ctx);
 
+rbuf_res rbuf_init(rbuf_ctx **ctx, rbuf_ctx_storage *storage, rbuf_conf *conf);
+
+rbuf_res rbuf_deinit(rbuf_ctx *ctx);
+
 rbuf_res rbuf_status(rbuf_ctx *ctx, rbuf_stat *stat);
 
+rbuf_res rbuf_status64(rbuf_ctx *ctx, rbuf_stat64 *stat);
+
+#ifdef RBUF_STATS
+
+rbuf_res rbuf_status_ext(rbuf_ctx *ctx, rbuf_stat_ext *stat);
+
+#endif
+
 rbuf_res rbuf_resize(rbuf_ctx *ctx, rbuf_u32 size);
 
+rbuf_res rbuf_resize64(rbuf_ctx *ctx, rbuf_u64 size);
+
+rbuf_res rbuf_trim(rbuf_ctx *ctx);
+
 rbuf_res rbuf_copy_from(rbuf_ctx *ctx, const void *buff, rbuf_u32 offs, rbuf_u32 size);
 
+rbuf_res rbuf_copy_from64(rbuf_ctx *ctx, const void *buff, rbuf_u64 offs, rbuf_u64 size);
+
 rbuf_res rbuf_append(rbuf_ctx *ctx, const void *buff, rbuf_u32 size);
 
+rbuf_res rbuf_reserve(rbuf_ctx *ctx, void **ptr, rbuf_u32 *size);
+
+rbuf_res rbuf_commit(rbuf_ctx *ctx, rbuf_u32 size);
+
+rbuf_res rbuf_consume(rbuf_ctx *ctx, rbuf_u32 size);
+
 rbuf_res rbuf_copy_to(rbuf_ctx *ctx, void *buff, rbuf_u32 offs, rbuf_u32 size);
 
+rbuf_res rbuf_copy_to64(rbuf_ctx *ctx, void *buff, rbuf_u64 offs, rbuf_u64 size);
+
+rbuf_res rbuf_copy_to_batch(rbuf_ctx *ctx, const rbuf_range *ranges, rbuf_u32 num);
+
+rbuf_res rbuf_copy_from_batch(rbuf_ctx *ctx, const rbuf_range *ranges, rbuf_u32 num);
+
+rbuf_res rbuf_split(rbuf_ctx *ctx, void *buff, rbuf_u64 offs, rbuf_u64 size, rbuf_range *parts, rbuf_u32 *part_num);
+
+rbuf_res rbuf_copy_from_parallel(rbuf_ctx *ctx, const void *buff, rbuf_u64 offs, rbuf_u64 size, rbuf_u32 part_num, rbuf_exec exec, void *user);
+
+rbuf_res rbuf_cursor_init(rbuf_cursor *cur, rbuf_ctx *ctx, rbuf_u64 offs);
+
+rbuf_res rbuf_cursor_seek(rbuf_cursor *cur, rbuf_u64 offs);
+
+rbuf_res rbuf_cursor_read(rbuf_cursor *cur, void *buff, rbuf_u64 size);
+
+rbuf_res rbuf_cursor_next_chunk(rbuf_cursor *cur, void **ptr, rbuf_u32 *size);
+
+rbuf_res rbuf_peek_iov(rbuf_ctx *ctx, rbuf_u32 offs, rbuf_u32 size, rbuf_iovec *iov, int *iovcnt);
+
+rbuf_res rbuf_linearize(rbuf_ctx *ctx, rbuf_u64 offs, rbuf_u64 size, void **ptr);
+
+rbuf_res rbuf_fill(rbuf_ctx *ctx, rbuf_u8 byte, rbuf_u64 offs, rbuf_u64 size);
+
+rbuf_res rbuf_compare(rbuf_ctx *ctx, const void *buff, rbuf_u64 offs, rbuf_u64 size, int *diff);
+
+rbuf_res rbuf_find_byte(rbuf_ctx *ctx, rbuf_u8 byte, rbuf_u64 offs, rbuf_u64 size, rbuf_u64 *pos);
+
+rbuf_res rbuf_find_seq(rbuf_ctx *ctx, const void *seq, rbuf_u32 seq_size, rbuf_u64 offs, rbuf_u64 size, rbuf_u64 *pos);
+
+rbuf_res rbuf_insert(rbuf_ctx *ctx, const void *buff, rbuf_u64 offs, rbuf_u64 size);
+
+rbuf_res rbuf_erase(rbuf_ctx *ctx, rbuf_u64 offs, rbuf_u64 size);
+
+rbuf_res rbuf_clone(rbuf_ctx *ctx, rbuf_ctx **clone);
+
+rbuf_res rbuf_slice(rbuf_ctx *ctx, rbuf_u64 offs, rbuf_u64 size, rbuf_ctx **slice);
+
+rbuf_res rbuf_splice(rbuf_ctx *dst, rbuf_ctx *src);
+
+rbuf_res rbuf_checksum(rbuf_ctx *ctx, rbuf_u32 *crc);
+
+rbuf_res rbuf_recycle_trim(void);
+
+#ifdef RBUF_HAS_SYS_UIO
+
+rbuf_res rbuf_read_fd(rbuf_ctx *ctx, int fd, rbuf_u32 size, rbuf_u32 *done);
+
+rbuf_res rbuf_write_fd(rbuf_ctx *ctx, int fd, rbuf_u32 size, rbuf_u32 *done);
+
+rbuf_res rbuf_save(rbuf_ctx *ctx, int fd);
+
+rbuf_res rbuf_load(rbuf_ctx *ctx, int fd);
+
+#endif
+
 #endif
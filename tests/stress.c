@@ -0,0 +1,581 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2023 Alex Chen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * threaded stress test of the modes used from several threads at once,
+ * meant to be run under ThreadSanitizer, and under LeakSanitizer for the
+ * chunks of the exited threads, "make stress" does both:
+ * 
+ *     cc -O1 -g -fsanitize=thread -I. tests/stress.c resizablebuffer.c -o rbuf_stress -lpthread
+ *     ./rbuf_stress
+ * 
+ * the parts are:
+ *   spsc        one producer appends records while one consumer copies
+ *               them out and consumes them, in "RBUF_FLAG_SPSC".
+ *   concurrent  threads copy into and out of their own stripes of one
+ *               buffer, and read a shared range, in "RBUF_FLAG_CONCURRENT",
+ *               then copy the parts rbuf_split() cuts a range into, and
+ *               run rbuf_copy_from_parallel() through a thread executor.
+ *   recycle     threads create, fill and delete buffers, some of them
+ *               handed over to be deleted on another thread, in
+ *               "RBUF_FLAG_RECYCLE", then a thread which only allocates
+ *               takes chunks freed by another one and exits.
+ * 
+ * every byte written is a function of its position, so each thread checks
+ * what it reads on its own, and a mismatch exits with EXIT_FAILURE.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "resizablebuffer.h"
+
+/* number of worker threads of the concurrent and the recycler parts. */
+#define STRESS_THREAD_NUM       4
+
+/* bytes passed from the producer to the consumer. */
+#define STRESS_SPSC_SIZE        (4 * 1024 * 1024)
+
+/* size of the ring of the single-producer/single-consumer mode. */
+#define STRESS_SPSC_RING        4096
+
+/* size of the buffer of the concurrent part, and of one stripe. */
+#define STRESS_CONC_SIZE        (4 * 1024 * 1024)
+#define STRESS_CONC_STRIPE      1000
+
+/* size of the range every thread reads in the concurrent part. */
+#define STRESS_CONC_SHARED      (64 * 1024)
+
+/* buffers each thread of the recycler part goes through. */
+#define STRESS_RECYCLE_NUM      2000
+
+/* slots of the buffers handed over between the recycler threads. */
+#define STRESS_HANDOFF_NUM      16
+
+/* rounds of the allocating-only thread of the recycler part. */
+#define STRESS_TAKER_NUM        50
+
+#define STRESS_CHECK(expr) \
+    do { \
+        if (!(expr)) { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #expr); \
+            exit(EXIT_FAILURE); \
+        } \
+    } while (0)
+
+/* a worker of the concurrent and the recycler parts. */
+typedef struct _stress_worker {
+    pthread_t thread;
+    rbuf_u32 idx;
+} stress_worker;
+
+static rbuf_ctx *stress_ctx;
+
+/* parts of the range the concurrent part splits among its threads. */
+static rbuf_range stress_parts[STRESS_THREAD_NUM];
+
+/* buffers handed over by the recycler threads, NULL for a free slot. */
+static rbuf_ctx *stress_handoff[STRESS_HANDOFF_NUM];
+static pthread_mutex_t stress_handoff_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* the byte found at a position of every buffer. */
+static rbuf_u8 stress_byte(rbuf_u64 pos) {
+    return (rbuf_u8)(pos * 131 + (pos >> 11) + 7);
+}
+
+static void stress_pattern(rbuf_u8 *buff, rbuf_u64 pos, rbuf_u64 size) {
+    for (rbuf_u64 i = 0; i < size; i++) {
+        buff[i] = stress_byte(pos + i);
+    }
+}
+
+static void stress_pattern_check(const rbuf_u8 *buff, rbuf_u64 pos, rbuf_u64 size) {
+    for (rbuf_u64 i = 0; i < size; i++) {
+        STRESS_CHECK(buff[i] == stress_byte(pos + i));
+    }
+}
+
+/* linear congruential step, rand() isn't safe to share between threads. */
+static rbuf_u32 stress_rand(rbuf_u32 *state) {
+    *state = *state * 1103515245u + 12345u;
+
+    return *state >> 8;
+}
+
+static rbuf_ctx *stress_new(rbuf_u32 block_size, rbuf_u32 slab_block_num, rbuf_u32 flags, rbuf_u64 size_max) {
+    rbuf_ctx *ctx;
+    rbuf_conf conf;
+
+    rbuf_conf_init(&conf);
+    conf.block_size = block_size;
+    conf.slab_block_num = slab_block_num;
+    conf.flags = flags;
+    conf.size_max = size_max;
+
+    STRESS_CHECK(rbuf_new(&ctx, &conf) == RBUF_OK);
+
+    return ctx;
+}
+
+static void *stress_spsc_producer(void *arg) {
+    rbuf_u8 record[300];
+    rbuf_u32 state = 1;
+    rbuf_u64 pos;
+    rbuf_u32 size;
+    rbuf_res res;
+
+    (void)arg;
+
+    for (pos = 0; pos < STRESS_SPSC_SIZE; pos += size) {
+        size = 1 + stress_rand(&state) % sizeof(record);
+        if (size > STRESS_SPSC_SIZE - pos) {
+            size = (rbuf_u32)(STRESS_SPSC_SIZE - pos);
+        }
+        stress_pattern(record, pos, size);
+
+        /* the ring is full until the consumer catches up. */
+        while ((res = rbuf_append(stress_ctx, record, size)) == RBUF_ERR_BAD_SIZE) {
+            sched_yield();
+        }
+        STRESS_CHECK(res == RBUF_OK);
+    }
+
+    return NULL;
+}
+
+static void *stress_spsc_consumer(void *arg) {
+    rbuf_u8 buff[512];
+    rbuf_u32 state = 2;
+    rbuf_stat stat;
+    rbuf_u64 pos;
+    rbuf_u32 size;
+
+    (void)arg;
+
+    for (pos = 0; pos < STRESS_SPSC_SIZE; pos += size) {
+        STRESS_CHECK(rbuf_status(stress_ctx, &stat) == RBUF_OK);
+        if (stat.buff_size == 0) {
+            size = 0;
+            sched_yield();
+            continue;
+        }
+
+        size = 1 + stress_rand(&state) % sizeof(buff);
+        if (size > stat.buff_size) {
+            size = stat.buff_size;
+        }
+
+        STRESS_CHECK(rbuf_copy_to(stress_ctx, buff, 0, size) == RBUF_OK);
+        stress_pattern_check(buff, pos, size);
+        STRESS_CHECK(rbuf_consume(stress_ctx, size) == RBUF_OK);
+    }
+
+    return NULL;
+}
+
+static void stress_spsc(void) {
+    static const rbuf_u32 block_sizes[] = {64, 1000};
+    pthread_t producer;
+    pthread_t consumer;
+    rbuf_stat stat;
+
+    /* block sizes which do and don't divide the ring. */
+    for (size_t i = 0; i < sizeof(block_sizes) / sizeof(block_sizes[0]); i++) {
+        stress_ctx = stress_new(block_sizes[i], 0, RBUF_FLAG_SPSC, STRESS_SPSC_RING);
+
+        STRESS_CHECK(pthread_create(&producer, NULL, stress_spsc_producer, NULL) == 0);
+        STRESS_CHECK(pthread_create(&consumer, NULL, stress_spsc_consumer, NULL) == 0);
+        STRESS_CHECK(pthread_join(producer, NULL) == 0);
+        STRESS_CHECK(pthread_join(consumer, NULL) == 0);
+
+        STRESS_CHECK(rbuf_status(stress_ctx, &stat) == RBUF_OK);
+        STRESS_CHECK(stat.buff_size == 0);
+        STRESS_CHECK(rbuf_del(stress_ctx) == RBUF_OK);
+    }
+
+    printf("spsc: ok\n");
+}
+
+/* each thread writes and reads back the stripes whose index matches its
+   own, and reads the shared range at the front, which nobody writes. */
+static void *stress_conc_worker(void *arg) {
+    stress_worker *worker = (stress_worker *)arg;
+    rbuf_u8 data[STRESS_CONC_STRIPE];
+    rbuf_u8 back[STRESS_CONC_STRIPE];
+    rbuf_u8 shared[256];
+    rbuf_u32 state = worker->idx + 1;
+    rbuf_range ranges[2];
+    rbuf_cursor cur;
+    rbuf_u64 offs;
+    rbuf_u64 size;
+    rbuf_u64 pos;
+
+    for (offs = STRESS_CONC_SHARED + (rbuf_u64)worker->idx * STRESS_CONC_STRIPE;
+         offs < STRESS_CONC_SIZE;
+         offs += (rbuf_u64)STRESS_THREAD_NUM * STRESS_CONC_STRIPE) {
+        size = STRESS_CONC_SIZE - offs;
+        if (size > STRESS_CONC_STRIPE) {
+            size = STRESS_CONC_STRIPE;
+        }
+
+        stress_pattern(data, offs, size);
+
+        /* the stripe goes in whole or as two batched halves. */
+        if (stress_rand(&state) % 2 == 0) {
+            STRESS_CHECK(rbuf_copy_from64(stress_ctx, data, offs, size) == RBUF_OK);
+        } else {
+            ranges[0].buff = data;
+            ranges[0].offs = offs;
+            ranges[0].size = size / 2;
+            ranges[1].buff = data + size / 2;
+            ranges[1].offs = offs + size / 2;
+            ranges[1].size = size - size / 2;
+            STRESS_CHECK(rbuf_copy_from_batch(stress_ctx, ranges, 2) == RBUF_OK);
+        }
+
+        STRESS_CHECK(rbuf_copy_to64(stress_ctx, back, offs, size) == RBUF_OK);
+        stress_pattern_check(back, offs, size);
+
+        /* the shared range, through the copying and the cursor. */
+        pos = stress_rand(&state) % (STRESS_CONC_SHARED - sizeof(shared));
+        STRESS_CHECK(rbuf_copy_to64(stress_ctx, shared, pos, sizeof(shared)) == RBUF_OK);
+        stress_pattern_check(shared, pos, sizeof(shared));
+
+        STRESS_CHECK(rbuf_cursor_init(&cur, stress_ctx, pos) == RBUF_OK);
+        STRESS_CHECK(rbuf_cursor_read(&cur, shared, sizeof(shared)) == RBUF_OK);
+        stress_pattern_check(shared, pos, sizeof(shared));
+    }
+
+    return NULL;
+}
+
+/* copy one part of the range split by rbuf_split(). */
+static void *stress_part_worker(void *arg) {
+    stress_worker *worker = (stress_worker *)arg;
+
+    STRESS_CHECK(rbuf_copy_from_batch(stress_ctx, &stress_parts[worker->idx], 1) == RBUF_OK);
+
+    return NULL;
+}
+
+/* a task of stress_exec() run on its own thread. */
+typedef struct _stress_task {
+    pthread_t thread;
+    void (*task)(void *arg, rbuf_u32 idx);
+    void *arg;
+    rbuf_u32 idx;
+} stress_task;
+
+static void *stress_task_run(void *arg) {
+    stress_task *task = (stress_task *)arg;
+
+    task->task(task->arg, task->idx);
+
+    return NULL;
+}
+
+/* executor of rbuf_copy_from_parallel(), the calling thread runs the
+   first task, "user" counts the calls. */
+static void stress_exec(void *user, void (*task)(void *arg, rbuf_u32 idx), void *arg, rbuf_u32 num) {
+    stress_task tasks[STRESS_THREAD_NUM];
+
+    STRESS_CHECK(num >= 2 && num <= STRESS_THREAD_NUM);
+    (*(rbuf_u32 *)user)++;
+
+    for (rbuf_u32 i = 1; i < num; i++) {
+        tasks[i].task = task;
+        tasks[i].arg = arg;
+        tasks[i].idx = i;
+        STRESS_CHECK(pthread_create(&tasks[i].thread, NULL, stress_task_run, &tasks[i]) == 0);
+    }
+
+    task(arg, 0);
+
+    for (rbuf_u32 i = 1; i < num; i++) {
+        STRESS_CHECK(pthread_join(tasks[i].thread, NULL) == 0);
+    }
+}
+
+static void stress_concurrent(void) {
+    stress_worker workers[STRESS_THREAD_NUM];
+    static rbuf_u8 data[STRESS_CONC_SIZE];
+    rbuf_stat64 stat;
+    rbuf_ctx *ctx;
+    void *ptr;
+    rbuf_u32 room;
+    rbuf_u32 done;
+    rbuf_u32 part_num;
+    rbuf_u32 exec_num;
+
+    stress_ctx = stress_new(4096, 0, RBUF_FLAG_CONCURRENT, 0);
+    STRESS_CHECK(rbuf_resize64(stress_ctx, STRESS_CONC_SIZE) == RBUF_OK);
+
+    stress_pattern(data, 0, STRESS_CONC_SIZE);
+    STRESS_CHECK(rbuf_copy_from64(stress_ctx, data, 0, STRESS_CONC_SHARED) == RBUF_OK);
+
+    for (rbuf_u32 i = 0; i < STRESS_THREAD_NUM; i++) {
+        workers[i].idx = i;
+        STRESS_CHECK(pthread_create(&workers[i].thread, NULL, stress_conc_worker, &workers[i]) == 0);
+    }
+
+    for (rbuf_u32 i = 0; i < STRESS_THREAD_NUM; i++) {
+        STRESS_CHECK(pthread_join(workers[i].thread, NULL) == 0);
+    }
+
+    memset(data, 0, STRESS_CONC_SIZE);
+    STRESS_CHECK(rbuf_copy_to64(stress_ctx, data, 0, STRESS_CONC_SIZE) == RBUF_OK);
+    stress_pattern_check(data, 0, STRESS_CONC_SIZE);
+
+    /* nothing grows the buffer in this mode. */
+    STRESS_CHECK(rbuf_copy_from64(stress_ctx, data, STRESS_CONC_SIZE - 1, 2) == RBUF_ERR_BAD_SIZE);
+    STRESS_CHECK(rbuf_append(stress_ctx, data, 1) == RBUF_ERR_BAD_SIZE);
+    STRESS_CHECK(rbuf_reserve(stress_ctx, &ptr, &room) == RBUF_ERR_BAD_SIZE);
+    STRESS_CHECK(rbuf_commit(stress_ctx, 0) == RBUF_ERR_BAD_SIZE);
+    STRESS_CHECK(rbuf_read_fd(stress_ctx, 0, 1, &done) == RBUF_ERR_BAD_SIZE);
+    STRESS_CHECK(rbuf_fill(stress_ctx, 'x', STRESS_CONC_SIZE - 1, 2) == RBUF_ERR_BAD_SIZE);
+    STRESS_CHECK(rbuf_insert(stress_ctx, data, 1, 1) == RBUF_ERR_BAD_SIZE);
+    STRESS_CHECK(rbuf_insert(stress_ctx, data, STRESS_CONC_SIZE, 1) == RBUF_ERR_BAD_SIZE);
+    STRESS_CHECK(rbuf_load(stress_ctx, 0) == RBUF_ERR_BAD_SIZE);
+    ctx = stress_new(1000, 0, 0, 0);
+    STRESS_CHECK(rbuf_append(ctx, data, 5) == RBUF_OK);
+    STRESS_CHECK(rbuf_splice(stress_ctx, ctx) == RBUF_ERR_BAD_SIZE);
+    STRESS_CHECK(rbuf_del(ctx) == RBUF_OK);
+    STRESS_CHECK(rbuf_status64(stress_ctx, &stat) == RBUF_OK);
+    STRESS_CHECK(stat.buff_size == STRESS_CONC_SIZE);
+    STRESS_CHECK(rbuf_del(stress_ctx) == RBUF_OK);
+
+    /* the parts of rbuf_split(), each copied on its own thread. */
+    stress_ctx = stress_new(1000, 0, RBUF_FLAG_CONCURRENT, 0);
+    STRESS_CHECK(rbuf_resize64(stress_ctx, STRESS_CONC_SIZE) == RBUF_OK);
+    stress_pattern(data, 0, STRESS_CONC_SIZE);
+    part_num = STRESS_THREAD_NUM;
+    STRESS_CHECK(rbuf_split(stress_ctx, data + 2, 2, STRESS_CONC_SIZE - 2, stress_parts, &part_num) == RBUF_OK);
+    STRESS_CHECK(part_num == STRESS_THREAD_NUM);
+
+    for (rbuf_u32 i = 0; i < part_num; i++) {
+        workers[i].idx = i;
+        STRESS_CHECK(pthread_create(&workers[i].thread, NULL, stress_part_worker, &workers[i]) == 0);
+    }
+
+    for (rbuf_u32 i = 0; i < part_num; i++) {
+        STRESS_CHECK(pthread_join(workers[i].thread, NULL) == 0);
+    }
+
+    memset(data, 0, STRESS_CONC_SIZE);
+    STRESS_CHECK(rbuf_copy_to64(stress_ctx, data + 2, 2, STRESS_CONC_SIZE - 2) == RBUF_OK);
+    stress_pattern_check(data + 2, 2, STRESS_CONC_SIZE - 2);
+    STRESS_CHECK(rbuf_del(stress_ctx) == RBUF_OK);
+
+    /* the parallel helper, on a buffer with data in front, which it grows. */
+    ctx = stress_new(1000, 0, 0, 0);
+    STRESS_CHECK(rbuf_append(ctx, data, 5) == RBUF_OK);
+    STRESS_CHECK(rbuf_consume(ctx, 3) == RBUF_OK);
+    stress_pattern(data, 0, STRESS_CONC_SIZE);
+    exec_num = 0;
+    STRESS_CHECK(rbuf_copy_from_parallel(ctx, data + 2, 2, STRESS_CONC_SIZE - 2, STRESS_THREAD_NUM,
+                                         stress_exec, &exec_num) == RBUF_OK);
+    STRESS_CHECK(exec_num == 1);
+
+    memset(data, 0, STRESS_CONC_SIZE);
+    STRESS_CHECK(rbuf_copy_to64(ctx, data + 2, 2, STRESS_CONC_SIZE - 2) == RBUF_OK);
+    stress_pattern_check(data + 2, 2, STRESS_CONC_SIZE - 2);
+    STRESS_CHECK(rbuf_del(ctx) == RBUF_OK);
+
+    /* and on a concurrent buffer, which it can't grow. */
+    stress_ctx = stress_new(4096, 0, RBUF_FLAG_CONCURRENT, 0);
+    STRESS_CHECK(rbuf_resize64(stress_ctx, STRESS_CONC_SIZE) == RBUF_OK);
+    stress_pattern(data, 0, STRESS_CONC_SIZE);
+    STRESS_CHECK(rbuf_copy_from_parallel(stress_ctx, data, 1, STRESS_CONC_SIZE, STRESS_THREAD_NUM,
+                                         stress_exec, &exec_num) == RBUF_ERR_BAD_SIZE);
+    STRESS_CHECK(rbuf_copy_from_parallel(stress_ctx, data, 0, STRESS_CONC_SIZE, STRESS_THREAD_NUM,
+                                         stress_exec, &exec_num) == RBUF_OK);
+    STRESS_CHECK(exec_num == 2);
+
+    memset(data, 0, STRESS_CONC_SIZE);
+    STRESS_CHECK(rbuf_copy_to64(stress_ctx, data, 0, STRESS_CONC_SIZE) == RBUF_OK);
+    stress_pattern_check(data, 0, STRESS_CONC_SIZE);
+    STRESS_CHECK(rbuf_del(stress_ctx) == RBUF_OK);
+
+    printf("concurrent: ok\n");
+}
+
+/* fill a buffer and check it, the data depends on the buffer size. */
+static void stress_recycle_fill(rbuf_ctx *ctx, rbuf_u32 size) {
+    rbuf_u8 data[3000];
+    rbuf_u32 curt_size;
+
+    for (rbuf_u32 pos = 0; pos < size; pos += curt_size) {
+        curt_size = size - pos;
+        if (curt_size > sizeof(data)) {
+            curt_size = sizeof(data);
+        }
+
+        stress_pattern(data, pos, curt_size);
+        STRESS_CHECK(rbuf_append(ctx, data, curt_size) == RBUF_OK);
+    }
+}
+
+static void stress_recycle_check(rbuf_ctx *ctx) {
+    rbuf_u8 data[3000];
+    rbuf_u32 curt_size;
+    rbuf_stat stat;
+
+    STRESS_CHECK(rbuf_status(ctx, &stat) == RBUF_OK);
+    for (rbuf_u32 pos = 0; pos < stat.buff_size; pos += curt_size) {
+        curt_size = stat.buff_size - pos;
+        if (curt_size > sizeof(data)) {
+            curt_size = sizeof(data);
+        }
+
+        STRESS_CHECK(rbuf_copy_to(ctx, data, pos, curt_size) == RBUF_OK);
+        stress_pattern_check(data, pos, curt_size);
+    }
+}
+
+/* the buffers are deleted right away, or swapped with one in the handoff
+   slots, so the chunks go back on a thread other than the one which
+   took them. */
+static void *stress_recycle_worker(void *arg) {
+    stress_worker *worker = (stress_worker *)arg;
+    rbuf_u32 state = worker->idx + 1;
+    rbuf_u32 slot;
+    rbuf_ctx *other;
+    rbuf_ctx *ctx;
+
+    for (rbuf_u32 i = 0; i < STRESS_RECYCLE_NUM; i++) {
+        if (stress_rand(&state) % 2 == 0) {
+            ctx = stress_new(4096, 1, RBUF_FLAG_RECYCLE, 0);
+        } else {
+            ctx = stress_new(1000, 3, RBUF_FLAG_RECYCLE, 0);
+        }
+
+        stress_recycle_fill(ctx, stress_rand(&state) % (64 * 1024));
+
+        if (stress_rand(&state) % 2 == 0) {
+            slot = stress_rand(&state) % STRESS_HANDOFF_NUM;
+
+            STRESS_CHECK(pthread_mutex_lock(&stress_handoff_lock) == 0);
+            other = stress_handoff[slot];
+            stress_handoff[slot] = ctx;
+            ctx = other;
+            STRESS_CHECK(pthread_mutex_unlock(&stress_handoff_lock) == 0);
+
+            if (ctx == NULL) {
+                continue;
+            }
+        }
+
+        stress_recycle_check(ctx);
+        STRESS_CHECK(rbuf_del(ctx) == RBUF_OK);
+    }
+
+    return NULL;
+}
+
+/* frees chunks to the recycler, they reach the depot when it exits. */
+static void *stress_recycle_giver(void *arg) {
+    rbuf_ctx *ctxs[64];
+
+    (void)arg;
+
+    for (rbuf_u32 i = 0; i < 64; i++) {
+        ctxs[i] = stress_new(1000, 1, RBUF_FLAG_RECYCLE, 0);
+        STRESS_CHECK(rbuf_resize(ctxs[i], 1000) == RBUF_OK);
+    }
+
+    for (rbuf_u32 i = 0; i < 64; i++) {
+        STRESS_CHECK(rbuf_del(ctxs[i]) == RBUF_OK);
+    }
+
+    return NULL;
+}
+
+/* takes a batch of chunks from the depot and exits without freeing any,
+   the batch must go back to the depot then. */
+static void *stress_recycle_taker(void *arg) {
+    rbuf_ctx *ctx;
+
+    ctx = stress_new(1000, 1, RBUF_FLAG_RECYCLE, 0);
+    STRESS_CHECK(rbuf_resize(ctx, 1000) == RBUF_OK);
+    *(rbuf_ctx **)arg = ctx;
+
+    return NULL;
+}
+
+static void stress_recycle_taken(void) {
+    pthread_t thread;
+    rbuf_ctx *ctx;
+
+    for (rbuf_u32 i = 0; i < STRESS_TAKER_NUM; i++) {
+        STRESS_CHECK(pthread_create(&thread, NULL, stress_recycle_giver, NULL) == 0);
+        STRESS_CHECK(pthread_join(thread, NULL) == 0);
+
+        STRESS_CHECK(pthread_create(&thread, NULL, stress_recycle_taker, &ctx) == 0);
+        STRESS_CHECK(pthread_join(thread, NULL) == 0);
+
+        STRESS_CHECK(rbuf_del(ctx) == RBUF_OK);
+    }
+
+    STRESS_CHECK(rbuf_recycle_trim() == RBUF_OK);
+}
+
+static void stress_recycle(void) {
+    stress_worker workers[STRESS_THREAD_NUM];
+
+    for (rbuf_u32 i = 0; i < STRESS_THREAD_NUM; i++) {
+        workers[i].idx = i;
+        STRESS_CHECK(pthread_create(&workers[i].thread, NULL, stress_recycle_worker, &workers[i]) == 0);
+    }
+
+    for (rbuf_u32 i = 0; i < STRESS_THREAD_NUM; i++) {
+        STRESS_CHECK(pthread_join(workers[i].thread, NULL) == 0);
+    }
+
+    for (rbuf_u32 i = 0; i < STRESS_HANDOFF_NUM; i++) {
+        if (stress_handoff[i] != NULL) {
+            stress_recycle_check(stress_handoff[i]);
+            STRESS_CHECK(rbuf_del(stress_handoff[i]) == RBUF_OK);
+            stress_handoff[i] = NULL;
+        }
+    }
+
+    STRESS_CHECK(rbuf_recycle_trim() == RBUF_OK);
+
+    stress_recycle_taken();
+
+    printf("recycle: ok\n");
+}
+
+int main(void) {
+    stress_spsc();
+    stress_concurrent();
+    stress_recycle();
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,1189 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2023 Alex Chen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * randomized test of the resizable buffer against a flat array holding the
+ * same data, and of rbuf_checksum() against a bitwise CRC-32C.
+ * 
+ * build and run it from the repository root, "make test" does the same:
+ * 
+ *     cc -O1 -g -fsanitize=address,undefined -I. tests/test.c resizablebuffer.c -o rbuf_test
+ *     ./rbuf_test
+ * 
+ * the operations are run in every mode listed in "test_modes", with several
+ * block sizes, the first argument overrides the number of operations per
+ * run. a mismatch prints the mode, the block size and the operation number,
+ * and the program exits with EXIT_FAILURE.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "resizablebuffer.h"
+
+/* largest data size of the model, the buffer is emptied before it. */
+#define TEST_SIZE_MAX           (256 * 1024)
+
+/* largest size of the data of one operation. */
+#define TEST_DATA_SIZE          3000
+
+/* default number of operations per mode and block size. */
+#define TEST_OP_NUM             20000
+
+/* size of the block pool of each context in the pool mode. */
+#define TEST_POOL_SIZE          (64 * 1024)
+
+#define TEST_CHECK(expr) \
+    do { \
+        if (!(expr)) { \
+            fprintf(stderr, "%s:%d: check failed: %s (mode %s, block size %u, op %u)\n", \
+                    __FILE__, __LINE__, #expr, test_mode_curt->name, test_block_size, test_op_idx); \
+            exit(EXIT_FAILURE); \
+        } \
+    } while (0)
+
+/* one mode of the buffer the operations are run in. */
+typedef struct _test_mode {
+    const char *name;
+    rbuf_u32 flags;
+    rbuf_u32 slab_block_num;
+
+    /* largest block size as a multiple of the block size, 0 for none. */
+    rbuf_u32 block_size_max;
+
+    /* whether each context gets a block pool. */
+    bool pool;
+
+    /* watermarks of the spare slab chunks. */
+    rbuf_u32 spare_low;
+    rbuf_u32 spare_high;
+
+    /* alignment of the blocks, 0 for any. */
+    rbuf_u32 block_align;
+} test_mode;
+
+/* flat model of a buffer. */
+typedef struct _test_model {
+    rbuf_u8 data[TEST_SIZE_MAX];
+    rbuf_u64 size;
+} test_model;
+
+/* memory of a block pool, aligned for a pointer. */
+typedef union _test_pool {
+    rbuf_u8 data[TEST_POOL_SIZE];
+    void *align_ptr;
+} test_pool;
+
+static const test_mode test_modes[] = {
+    {"plain", 0, 0, 0, false, 0, 0, 0},
+    {"slab", 0, 4, 0, false, 0, 0, 0},
+    {"spare", 0, 2, 0, false, 2, 6, 0},
+    {"aligned", 0, 0, 0, false, 0, 0, 64},
+    {"aligned-shared", RBUF_FLAG_SHARED | RBUF_FLAG_HUGE_PAGE, 0, 0, false, 0, 0, 16},
+    {"shared", RBUF_FLAG_SHARED, 4, 0, false, 0, 0, 0},
+    {"checksum", RBUF_FLAG_CHECKSUM, 0, 0, false, 0, 0, 0},
+    {"shared-checksum", RBUF_FLAG_SHARED | RBUF_FLAG_CHECKSUM, 4, 0, false, 0, 0, 0},
+    {"adaptive", 0, 0, 8, false, 0, 0, 0},
+    {"adaptive-wide", 0, 0, 512, false, 0, 0, 0},
+    {"mmap", RBUF_FLAG_MMAP, 0, 0, false, 0, 0, 0},
+    {"pool", 0, 0, 0, true, 0, 0, 0},
+    {"pool-checksum", RBUF_FLAG_CHECKSUM, 0, 0, true, 0, 0, 0},
+};
+
+/* block sizes each mode is run with, the adaptive mode takes only the
+   powers of two, and the pool only blocks holding a pointer. */
+#ifdef RBUF_BLOCK_SHIFT
+static const rbuf_u32 test_block_sizes[] = {(rbuf_u32)1 << RBUF_BLOCK_SHIFT};
+#else
+static const rbuf_u32 test_block_sizes[] = {1, 3, 64, 100, 512, 4096};
+#endif
+
+static const test_mode *test_mode_curt;
+static rbuf_u32 test_block_size;
+static rbuf_u32 test_op_idx;
+
+/* the buffer under test, and a second one, the source of the splicing
+   and the target of the snapshot loading. */
+static test_model test_main;
+static test_model test_side;
+
+/* scratch model of a slice. */
+static test_model test_part;
+
+static test_pool test_pools[2];
+
+/* bitwise CRC-32C, the reference the library is checked against. */
+static rbuf_u32 test_crc32c(const rbuf_u8 *data, rbuf_u64 size) {
+    rbuf_u32 crc = 0xffffffffu;
+
+    for (rbuf_u64 i = 0; i < size; i++) {
+        crc ^= data[i];
+        for (int k = 0; k < 8; k++) {
+            crc = (crc >> 1) ^ (0x82f63b78u & (0u - (crc & 1u)));
+        }
+    }
+
+    return ~crc;
+}
+
+static rbuf_u64 test_rand(rbuf_u64 bound) {
+    rbuf_u64 num;
+
+    num = ((rbuf_u64)rand() << 31) ^ (rbuf_u64)rand();
+
+    return (bound != 0) ? num % bound : 0;
+}
+
+static rbuf_ctx *test_new(int pool_idx) {
+    rbuf_ctx *ctx;
+    rbuf_conf conf;
+
+    rbuf_conf_init(&conf);
+    conf.block_size = test_block_size;
+    conf.size_max = 0;
+    conf.slab_block_num = test_mode_curt->slab_block_num;
+    conf.flags = test_mode_curt->flags;
+    conf.block_size_max = test_block_size * test_mode_curt->block_size_max;
+    conf.spare_low = test_mode_curt->spare_low;
+    conf.spare_high = test_mode_curt->spare_high;
+    conf.block_align = test_mode_curt->block_align;
+    if (test_mode_curt->pool) {
+        conf.pool = test_pools[pool_idx].data;
+        conf.pool_size = TEST_POOL_SIZE;
+    }
+
+    TEST_CHECK(rbuf_new(&ctx, &conf) == RBUF_OK);
+
+    return ctx;
+}
+
+/* compare the whole buffer and its checksum with the model. */
+static void test_verify(rbuf_ctx *ctx, const test_model *model) {
+    static rbuf_u8 data[TEST_SIZE_MAX];
+    rbuf_stat64 stat;
+    rbuf_u32 crc;
+
+    TEST_CHECK(rbuf_status64(ctx, &stat) == RBUF_OK);
+    TEST_CHECK(stat.buff_size == model->size);
+    TEST_CHECK(stat.block_num == 0 ||
+               stat.block_align >= test_mode_curt->block_align);
+
+    TEST_CHECK(rbuf_copy_to64(ctx, data, 0, model->size) == RBUF_OK);
+    TEST_CHECK(memcmp(data, model->data, (size_t)model->size) == 0);
+
+    TEST_CHECK(rbuf_checksum(ctx, &crc) == RBUF_OK);
+    TEST_CHECK(crc == test_crc32c(model->data, model->size));
+}
+
+/* compare a random range of the buffer with the model. */
+static void test_verify_range(rbuf_ctx *ctx, const test_model *model) {
+    rbuf_u64 offs;
+    rbuf_u64 size;
+    void *ptr;
+
+    offs = test_rand(model->size + 1);
+    size = test_rand(model->size - offs + 1);
+
+    TEST_CHECK(rbuf_linearize(ctx, offs, size, &ptr) == RBUF_OK);
+    TEST_CHECK(size == 0 ||
+               memcmp(ptr, model->data + offs, (size_t)size) == 0);
+}
+
+/* describe a random range of the buffer with pointers into the blocks, and
+   compare what they point to with the model, an array too small for the
+   range describes its leading part. */
+static void test_verify_iov(rbuf_ctx *ctx, const test_model *model) {
+    rbuf_iovec iov[8];
+    rbuf_u64 offs;
+    rbuf_u64 size;
+    rbuf_u64 pos;
+    int iovcnt;
+    int cap;
+
+    offs = test_rand(model->size + 1);
+    size = test_rand(model->size - offs + 1);
+    cap = 1 + rand() % 8;
+
+    iovcnt = cap;
+    TEST_CHECK(rbuf_peek_iov(ctx, (rbuf_u32)offs, (rbuf_u32)size, iov, &iovcnt) == RBUF_OK);
+    TEST_CHECK(iovcnt >= 0 && iovcnt <= cap);
+
+    pos = offs;
+    for (int i = 0; i < iovcnt; i++) {
+        TEST_CHECK(iov[i].iov_len != 0);
+        TEST_CHECK(iov[i].iov_len <= offs + size - pos);
+        TEST_CHECK(memcmp(iov[i].iov_base, model->data + pos, iov[i].iov_len) == 0);
+        pos += iov[i].iov_len;
+    }
+    TEST_CHECK(pos == offs + size || iovcnt == cap);
+
+    /* past the end there is nothing to describe. */
+    iovcnt = cap;
+    TEST_CHECK(rbuf_peek_iov(ctx, (rbuf_u32)model->size, 1, iov, &iovcnt) == RBUF_ERR_BAD_SIZE);
+}
+
+/* walk the buffer with a cursor from a random offset, by reads, chunks and
+   seeks, and compare what it gives with the model, up to the end. */
+static void test_verify_cursor(rbuf_ctx *ctx, const test_model *model) {
+    static rbuf_u8 data[TEST_DATA_SIZE];
+    rbuf_cursor cur;
+    rbuf_u64 offs;
+    rbuf_u64 size;
+    rbuf_u32 chunk_size;
+    void *ptr;
+
+    offs = test_rand(model->size + 1);
+    TEST_CHECK(rbuf_cursor_init(&cur, ctx, offs) == RBUF_OK);
+
+    for (rbuf_u32 i = 0; i < 64 && offs != model->size; i++) {
+        switch (rand() % 4) {
+        case 0:
+            offs = test_rand(model->size + 1);
+            TEST_CHECK(rbuf_cursor_seek(&cur, offs) == RBUF_OK);
+            break;
+
+        case 1:
+            TEST_CHECK(rbuf_cursor_next_chunk(&cur, &ptr, &chunk_size) == RBUF_OK);
+            TEST_CHECK(ptr != NULL);
+            TEST_CHECK(chunk_size != 0 && chunk_size <= model->size - offs);
+            TEST_CHECK(memcmp(ptr, model->data + offs, chunk_size) == 0);
+            offs += chunk_size;
+            break;
+
+        default:
+            size = test_rand(model->size - offs + 1);
+            if (size > TEST_DATA_SIZE) {
+                size = TEST_DATA_SIZE;
+            }
+            TEST_CHECK(rbuf_cursor_read(&cur, data, size) == RBUF_OK);
+            TEST_CHECK(memcmp(data, model->data + offs, (size_t)size) == 0);
+            offs += size;
+            break;
+        }
+    }
+
+    /* nothing is left past the end. */
+    TEST_CHECK(rbuf_cursor_seek(&cur, model->size) == RBUF_OK);
+    TEST_CHECK(rbuf_cursor_read(&cur, data, 1) == RBUF_ERR_BAD_SIZE);
+    TEST_CHECK(rbuf_cursor_next_chunk(&cur, &ptr, &chunk_size) == RBUF_OK);
+    TEST_CHECK(ptr == NULL && chunk_size == 0);
+    TEST_CHECK(rbuf_cursor_seek(&cur, model->size + 1) == RBUF_ERR_BAD_OFFS);
+}
+
+/* the sign of a comparison result. */
+static int test_sign(int diff) {
+    return (diff > 0) - (diff < 0);
+}
+
+/* compare a random range of the buffer with the model, as it is and with
+   one byte changed, the result must have the sign memcmp() gives. */
+static void test_verify_compare(rbuf_ctx *ctx, const test_model *model) {
+    static rbuf_u8 data[TEST_SIZE_MAX];
+    rbuf_u64 offs;
+    rbuf_u64 size;
+    rbuf_u64 pos;
+    int diff;
+
+    offs = test_rand(model->size + 1);
+    size = test_rand(model->size - offs + 1);
+
+    TEST_CHECK(rbuf_compare(ctx, model->data + offs, offs, size, &diff) == RBUF_OK);
+    TEST_CHECK(diff == 0);
+
+    if (size != 0) {
+        memcpy(data, model->data + offs, (size_t)size);
+        pos = test_rand(size);
+        data[pos] = (rbuf_u8)(data[pos] + 1 + rand() % 255);
+
+        TEST_CHECK(rbuf_compare(ctx, data, offs, size, &diff) == RBUF_OK);
+        TEST_CHECK(diff != 0);
+        TEST_CHECK(test_sign(diff) == test_sign(memcmp(model->data + offs, data, (size_t)size)));
+    }
+
+    TEST_CHECK(rbuf_compare(ctx, data, model->size, 1, &diff) == RBUF_ERR_BAD_SIZE);
+}
+
+/* find a random byte, and a sequence taken from the model, in a random
+   range of the buffer, the first occurrence must be the one of a plain
+   search of the model. */
+static void test_verify_find(rbuf_ctx *ctx, const test_model *model) {
+    const rbuf_u8 *found;
+    rbuf_u8 seq[3];
+    rbuf_u64 offs;
+    rbuf_u64 size;
+    rbuf_u64 seq_offs;
+    rbuf_u64 seq_size;
+    rbuf_u64 expect;
+    rbuf_u64 pos;
+    rbuf_res res;
+    rbuf_u8 byte;
+
+    offs = test_rand(model->size + 1);
+    size = test_rand(model->size - offs + 1);
+
+    byte = (size != 0 && rand() % 2 == 0) ? model->data[offs + test_rand(size)] : (rbuf_u8)rand();
+    found = (const rbuf_u8 *)memchr(model->data + offs, byte, (size_t)size);
+    res = rbuf_find_byte(ctx, byte, offs, size, &pos);
+    if (found == NULL) {
+        TEST_CHECK(res == RBUF_ERR_NOT_FOUND);
+    } else {
+        TEST_CHECK(res == RBUF_OK);
+        TEST_CHECK(pos == (rbuf_u64)(found - model->data));
+    }
+
+    seq_size = test_rand(((size < 64) ? size : 64) + 1);
+    seq_offs = offs + test_rand(size - seq_size + 1);
+    expect = offs;
+    while (memcmp(model->data + expect, model->data + seq_offs, (size_t)seq_size) != 0) {
+        expect++;
+    }
+
+    TEST_CHECK(rbuf_find_seq(ctx, model->data + seq_offs, (rbuf_u32)seq_size, offs, size, &pos) == RBUF_OK);
+    TEST_CHECK(pos == expect);
+
+    /* a sequence which is most likely nowhere. */
+    for (rbuf_u32 i = 0; i < sizeof(seq); i++) {
+        seq[i] = (rbuf_u8)rand();
+    }
+    for (expect = offs; expect + sizeof(seq) <= offs + size; expect++) {
+        if (memcmp(model->data + expect, seq, sizeof(seq)) == 0) {
+            break;
+        }
+    }
+
+    res = rbuf_find_seq(ctx, seq, sizeof(seq), offs, size, &pos);
+    if (expect + sizeof(seq) > offs + size) {
+        TEST_CHECK(res == RBUF_ERR_NOT_FOUND);
+    } else {
+        TEST_CHECK(res == RBUF_OK);
+        TEST_CHECK(pos == expect);
+    }
+}
+
+/* the data is written at most up to the end of the model. */
+static void test_model_write(test_model *model, const rbuf_u8 *data, rbuf_u64 offs, rbuf_u64 size) {
+    memcpy(model->data + offs, data, (size_t)size);
+    if (offs + size > model->size) {
+        model->size = offs + size;
+    }
+}
+
+/* copy the data in up to 4 ranges starting inside the buffer, they may
+   overlap and go past the end, and they are written in order. */
+static void test_batch_from(rbuf_ctx *ctx, test_model *model, const rbuf_u8 *data, rbuf_u64 size) {
+    rbuf_range ranges[4];
+    rbuf_u32 num;
+    rbuf_u64 pos;
+
+    num = 1 + (rbuf_u32)(rand() % 4);
+    pos = 0;
+    for (rbuf_u32 i = 0; i < num; i++) {
+        ranges[i].offs = test_rand(model->size + 1);
+        ranges[i].size = test_rand((size - pos) / (num - i) + 1);
+        ranges[i].buff = (void *)(data + pos);
+        pos += ranges[i].size;
+    }
+
+    /* a bad range fails the batch before anything is written. */
+    if (rand() % 8 == 0) {
+        ranges[num - 1].offs = (rbuf_u64)-1;
+        TEST_CHECK(rbuf_copy_from_batch(ctx, ranges, num) == RBUF_ERR_BAD_SIZE);
+
+        return;
+    }
+
+    TEST_CHECK(rbuf_copy_from_batch(ctx, ranges, num) == RBUF_OK);
+    for (rbuf_u32 i = 0; i < num; i++) {
+        test_model_write(model, (const rbuf_u8 *)ranges[i].buff, ranges[i].offs, ranges[i].size);
+    }
+}
+
+/* copy up to 4 ranges out, a bad one fails the batch before anything is
+   copied, so the external buffers keep their old bytes. */
+static void test_batch_to(rbuf_ctx *ctx, const test_model *model) {
+    static rbuf_u8 outs[4][TEST_DATA_SIZE];
+    rbuf_range ranges[4];
+    rbuf_u64 size;
+    rbuf_u32 num;
+    bool bad;
+
+    num = 1 + (rbuf_u32)(rand() % 4);
+    for (rbuf_u32 i = 0; i < num; i++) {
+        ranges[i].offs = test_rand(model->size + 1);
+        size = model->size - ranges[i].offs;
+        ranges[i].size = test_rand(((size < TEST_DATA_SIZE) ? size : TEST_DATA_SIZE) + 1);
+        ranges[i].buff = outs[i];
+        memset(outs[i], 0xa5, TEST_DATA_SIZE);
+    }
+
+    bad = rand() % 8 == 0;
+    if (bad) {
+        ranges[num - 1].offs = model->size;
+        ranges[num - 1].size = 1;
+        TEST_CHECK(rbuf_copy_to_batch(ctx, ranges, num) == RBUF_ERR_BAD_SIZE);
+    } else {
+        TEST_CHECK(rbuf_copy_to_batch(ctx, ranges, num) == RBUF_OK);
+    }
+
+    for (rbuf_u32 i = 0; i < num; i++) {
+        for (rbuf_u64 j = 0; j < ranges[i].size; j++) {
+            TEST_CHECK(outs[i][j] == (bad ? 0xa5 : model->data[ranges[i].offs + j]));
+        }
+    }
+}
+
+static void test_slice(rbuf_ctx *ctx, rbuf_u64 offs, rbuf_u64 size, FILE *file) {
+    int fd = fileno(file);
+    rbuf_u8 tail[8];
+    rbuf_ctx *slice;
+
+    TEST_CHECK(rbuf_slice(ctx, offs, size, &slice) == RBUF_OK);
+
+    memcpy(test_part.data, test_main.data + offs, (size_t)size);
+    test_part.size = size;
+    test_verify(slice, &test_part);
+
+    /* writing into a shared block copies it, the source stays as it is. */
+    for (int i = 0; i < 8; i++) {
+        tail[i] = (rbuf_u8)rand();
+    }
+    TEST_CHECK(rbuf_append(slice, tail, sizeof(tail)) == RBUF_OK);
+    test_model_write(&test_part, tail, test_part.size, sizeof(tail));
+    if (size != 0) {
+        TEST_CHECK(rbuf_fill(slice, tail[0], 0, 1) == RBUF_OK);
+        test_part.data[0] = tail[0];
+    }
+    test_verify(slice, &test_part);
+
+    /* a snapshot loaded into a fresh slice lands in its own blocks. */
+    TEST_CHECK(ftruncate(fd, 0) == 0);
+    TEST_CHECK(lseek(fd, 0, SEEK_SET) == 0);
+    TEST_CHECK(rbuf_save(slice, fd) == RBUF_OK);
+    TEST_CHECK(lseek(fd, 0, SEEK_SET) == 0);
+    TEST_CHECK(rbuf_del(slice) == RBUF_OK);
+
+    TEST_CHECK(rbuf_slice(ctx, offs, size, &slice) == RBUF_OK);
+    TEST_CHECK(rbuf_load(slice, fd) == RBUF_OK);
+    test_verify(slice, &test_part);
+    test_verify(ctx, &test_main);
+
+    TEST_CHECK(rbuf_del(slice) == RBUF_OK);
+}
+
+/* save the buffer, and load the snapshot into the side buffer, a snapshot
+   with a flipped bit, cut short or claiming more data than it has must be
+   refused and leave the side buffer as it was. */
+static void test_snapshot(rbuf_ctx *ctx, rbuf_ctx *side, FILE *file) {
+    int fd = fileno(file);
+    rbuf_u8 hdr[32];
+    rbuf_u8 byte;
+    rbuf_u64 size;
+    rbuf_u32 crc;
+    off_t pos;
+
+    TEST_CHECK(ftruncate(fd, 0) == 0);
+    TEST_CHECK(lseek(fd, 0, SEEK_SET) == 0);
+    TEST_CHECK(rbuf_save(ctx, fd) == RBUF_OK);
+    TEST_CHECK(lseek(fd, 0, SEEK_SET) == 0);
+
+    switch ((test_main.size != 0) ? rand() % 8 : 7) {
+    case 0:
+        pos = (off_t)(32 + test_rand(test_main.size));
+        TEST_CHECK(pread(fd, &byte, 1, pos) == 1);
+        byte ^= (rbuf_u8)(1u << (rand() % 8));
+        TEST_CHECK(pwrite(fd, &byte, 1, pos) == 1);
+
+        TEST_CHECK(rbuf_load(side, fd) == RBUF_ERR);
+        break;
+
+    case 1:
+        TEST_CHECK(ftruncate(fd, (off_t)(32 + test_rand(test_main.size))) == 0);
+
+        TEST_CHECK(rbuf_load(side, fd) == RBUF_ERR_BAD_SIZE);
+        break;
+
+    case 2:
+        /* a header with its own CRC right, but a size far beyond the file. */
+        TEST_CHECK(pread(fd, hdr, sizeof(hdr), 0) == (ssize_t)sizeof(hdr));
+        size = test_main.size + ((rbuf_u64)1 << 40);
+        for (rbuf_u32 i = 0; i < 8; i++) {
+            hdr[16 + i] = (rbuf_u8)(size >> (8 * i));
+        }
+        crc = test_crc32c(hdr, 24);
+        for (rbuf_u32 i = 0; i < 4; i++) {
+            hdr[24 + i] = (rbuf_u8)(crc >> (8 * i));
+        }
+        TEST_CHECK(pwrite(fd, hdr, sizeof(hdr), 0) == (ssize_t)sizeof(hdr));
+
+        TEST_CHECK(rbuf_load(side, fd) == RBUF_ERR_BAD_SIZE);
+        break;
+
+    default:
+        TEST_CHECK(rbuf_load(side, fd) == RBUF_OK);
+        memcpy(test_side.data, test_main.data, (size_t)test_main.size);
+        test_side.size = test_main.size;
+        break;
+    }
+
+    test_verify(side, &test_side);
+}
+
+static void test_run(rbuf_u32 op_num) {
+    static rbuf_u8 data[TEST_DATA_SIZE];
+    rbuf_ctx *ctx;
+    rbuf_ctx *side;
+    rbuf_u64 offs;
+    rbuf_u64 size;
+    rbuf_u64 num;
+    rbuf_u32 done;
+    rbuf_u32 room;
+    void *ptr;
+    FILE *file;
+    int fds[2];
+
+    ctx = test_new(0);
+    side = test_new(1);
+    test_main.size = 0;
+    test_side.size = 0;
+
+    file = tmpfile();
+    TEST_CHECK(file != NULL);
+    TEST_CHECK(pipe(fds) == 0);
+
+    for (test_op_idx = 0; test_op_idx < op_num; test_op_idx++) {
+        size = (rand() % 2 != 0) ? test_rand(8) : test_rand(TEST_DATA_SIZE + 1);
+        for (rbuf_u64 i = 0; i < size; i++) {
+            data[i] = (rbuf_u8)rand();
+        }
+
+        /* keep the models and the grown sizes below their capacity. */
+        if (test_side.size + 2 * TEST_DATA_SIZE > TEST_SIZE_MAX / 2) {
+            TEST_CHECK(rbuf_resize(side, 0) == RBUF_OK);
+            test_side.size = 0;
+        }
+        if (test_main.size + test_side.size + 2 * TEST_DATA_SIZE > TEST_SIZE_MAX) {
+            TEST_CHECK(rbuf_resize(ctx, 0) == RBUF_OK);
+            test_main.size = 0;
+        }
+
+        offs = test_rand(test_main.size + 1);
+
+        switch (rand() % 24) {
+        case 0:
+        case 1:
+            TEST_CHECK(rbuf_append(ctx, data, (rbuf_u32)size) == RBUF_OK);
+            test_model_write(&test_main, data, test_main.size, size);
+            break;
+
+        case 2:
+            TEST_CHECK(rbuf_copy_from64(ctx, data, offs, size) == RBUF_OK);
+            test_model_write(&test_main, data, offs, size);
+            break;
+
+        case 3:
+            TEST_CHECK(rbuf_reserve(ctx, &ptr, &room) == RBUF_OK);
+            TEST_CHECK(room != 0);
+            if (size > room) {
+                size = room;
+            }
+            memcpy(ptr, data, (size_t)size);
+            TEST_CHECK(rbuf_commit(ctx, (rbuf_u32)size) == RBUF_OK);
+            test_model_write(&test_main, data, test_main.size, size);
+            break;
+
+        case 4:
+            num = (rand() % 8 == 0) ? test_main.size : test_rand(test_main.size + 1);
+            TEST_CHECK(rbuf_consume(ctx, (rbuf_u32)num) == RBUF_OK);
+            memmove(test_main.data, test_main.data + num, (size_t)(test_main.size - num));
+            test_main.size -= num;
+            break;
+
+        case 5:
+            num = test_rand(test_main.size + TEST_DATA_SIZE);
+            TEST_CHECK(rbuf_resize64(ctx, num) == RBUF_OK);
+
+            /* the grown part holds whatever the blocks held. */
+            if (num > test_main.size) {
+                TEST_CHECK(rbuf_copy_to64(ctx, test_main.data + test_main.size,
+                                          test_main.size, num - test_main.size) == RBUF_OK);
+            }
+            test_main.size = num;
+            break;
+
+        case 6:
+            TEST_CHECK(rbuf_insert(ctx, data, offs, size) == RBUF_OK);
+            memmove(test_main.data + offs + size, test_main.data + offs,
+                    (size_t)(test_main.size - offs));
+            memcpy(test_main.data + offs, data, (size_t)size);
+            test_main.size += size;
+            break;
+
+        case 7:
+            if (size > test_main.size - offs) {
+                size = test_main.size - offs;
+            }
+            TEST_CHECK(rbuf_erase(ctx, offs, size) == RBUF_OK);
+            memmove(test_main.data + offs, test_main.data + offs + size,
+                    (size_t)(test_main.size - offs - size));
+            test_main.size -= size;
+            break;
+
+        case 8:
+            TEST_CHECK(rbuf_fill(ctx, data[0], offs, size) == RBUF_OK);
+            memset(test_main.data + offs, data[0], (size_t)size);
+            if (offs + size > test_main.size) {
+                test_main.size = offs + size;
+            }
+            break;
+
+        case 9:
+            if (size > 4096) {
+                size = 4096;
+            }
+            TEST_CHECK(write(fds[1], data, (size_t)size) == (ssize_t)size);
+            for (num = 0; num < size; num += done) {
+                TEST_CHECK(rbuf_read_fd(ctx, fds[0], (rbuf_u32)(size - num), &done) == RBUF_OK);
+                TEST_CHECK(done != 0);
+            }
+            test_model_write(&test_main, data, test_main.size, size);
+            break;
+
+        /* the side buffer is filled and consumed, and spliced
+           onto the end of the buffer from time to time. */
+        case 10:
+        case 11:
+            TEST_CHECK(rbuf_append(side, data, (rbuf_u32)size) == RBUF_OK);
+            test_model_write(&test_side, data, test_side.size, size);
+            if (rand() % 4 == 0) {
+                num = test_rand(test_side.size + 1);
+                TEST_CHECK(rbuf_consume(side, (rbuf_u32)num) == RBUF_OK);
+                memmove(test_side.data, test_side.data + num, (size_t)(test_side.size - num));
+                test_side.size -= num;
+            }
+            break;
+
+        case 12:
+            TEST_CHECK(rbuf_splice(ctx, side) == RBUF_OK);
+            test_model_write(&test_main, test_side.data, test_main.size, test_side.size);
+            test_side.size = 0;
+            test_verify(side, &test_side);
+            break;
+
+        case 13:
+            if ((test_mode_curt->flags & RBUF_FLAG_SHARED) != 0) {
+                if (size > test_main.size - offs) {
+                    size = test_main.size - offs;
+                }
+                test_slice(ctx, offs, size, file);
+            }
+            break;
+
+        case 14:
+            if (rand() % 16 == 0) {
+                test_snapshot(ctx, side, file);
+            }
+            break;
+
+        case 15:
+            test_verify_iov(ctx, &test_main);
+            break;
+
+        case 17:
+            test_verify_compare(ctx, &test_main);
+            break;
+
+        case 18:
+            test_verify_find(ctx, &test_main);
+            break;
+
+        case 19:
+            test_batch_from(ctx, &test_main, data, size);
+            break;
+
+        case 20:
+            test_batch_to(ctx, &test_main);
+            break;
+
+        case 21:
+            test_verify_cursor(ctx, &test_main);
+            break;
+
+        /* the front goes out through the pipe, and is consumed. */
+        case 16:
+            if (size > 4096) {
+                size = 4096;
+            }
+            if (size > test_main.size) {
+                size = test_main.size;
+            }
+            for (num = 0; num < size; num += done) {
+                TEST_CHECK(rbuf_write_fd(ctx, fds[1], (rbuf_u32)(size - num), &done) == RBUF_OK);
+                TEST_CHECK(done != 0);
+            }
+            TEST_CHECK(read(fds[0], data, (size_t)size) == (ssize_t)size);
+            TEST_CHECK(memcmp(data, test_main.data, (size_t)size) == 0);
+            memmove(test_main.data, test_main.data + size, (size_t)(test_main.size - size));
+            test_main.size -= size;
+            break;
+
+        default:
+            test_verify_range(ctx, &test_main);
+            break;
+        }
+
+        if (test_op_idx % 64 == 0) {
+            test_verify(ctx, &test_main);
+            test_verify(side, &test_side);
+        }
+    }
+
+    test_verify(ctx, &test_main);
+    test_verify(side, &test_side);
+
+    TEST_CHECK(rbuf_del(ctx) == RBUF_OK);
+    TEST_CHECK(rbuf_del(side) == RBUF_OK);
+    TEST_CHECK(close(fds[0]) == 0);
+    TEST_CHECK(close(fds[1]) == 0);
+    TEST_CHECK(fclose(file) == 0);
+}
+
+/* the checksum of the standard check string, and the modes which
+   can't keep the checksums. */
+static void test_checksum_basics(void) {
+    static const test_mode mode = {"checksum-basics", RBUF_FLAG_CHECKSUM, 0, 0, false, 0, 0, 0};
+    rbuf_ctx *ctx;
+    rbuf_conf conf;
+    rbuf_u32 crc;
+
+    test_mode_curt = &mode;
+#ifdef RBUF_BLOCK_SHIFT
+    test_block_size = (rbuf_u32)1 << RBUF_BLOCK_SHIFT;
+#else
+    test_block_size = 4;
+#endif
+    test_op_idx = 0;
+
+    ctx = test_new(0);
+    TEST_CHECK(rbuf_checksum(ctx, &crc) == RBUF_OK);
+    TEST_CHECK(crc == 0);
+    TEST_CHECK(rbuf_append(ctx, "123456789", 9) == RBUF_OK);
+    TEST_CHECK(rbuf_checksum(ctx, &crc) == RBUF_OK);
+    TEST_CHECK(crc == 0xe3069283u);
+    TEST_CHECK(rbuf_del(ctx) == RBUF_OK);
+
+    rbuf_conf_init(&conf);
+    conf.block_size = test_block_size;
+    conf.flags = RBUF_FLAG_CHECKSUM | RBUF_FLAG_SPSC;
+    TEST_CHECK(rbuf_new(&ctx, &conf) == RBUF_ERR);
+    conf.flags = RBUF_FLAG_CHECKSUM | RBUF_FLAG_CONCURRENT;
+    TEST_CHECK(rbuf_new(&ctx, &conf) == RBUF_ERR);
+}
+
+/* a configuration with only the fields of the first version set and the
+   rest zeroed behaves as the first version, and "RBUF_FLAG_MMAP" then maps
+   anonymous memory instead of the file at descriptor 0. */
+static void test_conf_zero(void) {
+    static const test_mode mode = {"conf-zero", 0, 0, 0, false, 0, 0, 0};
+    struct stat st;
+    rbuf_ctx *ctx;
+    rbuf_conf conf;
+    FILE *file;
+    int fd;
+
+    test_mode_curt = &mode;
+    test_block_size = test_block_sizes[0];
+    test_op_idx = 0;
+
+    /* a file in place of stdin, it must be left empty. */
+    file = tmpfile();
+    TEST_CHECK(file != NULL);
+    fd = dup(0);
+    TEST_CHECK(fd >= 0);
+    TEST_CHECK(dup2(fileno(file), 0) == 0);
+
+    memset(&conf, 0, sizeof(rbuf_conf));
+    conf.block_size = test_block_size;
+    conf.size_max = 1000;
+    TEST_CHECK(rbuf_new(&ctx, &conf) == RBUF_OK);
+    TEST_CHECK(rbuf_resize(ctx, 1000) == RBUF_OK);
+    TEST_CHECK(rbuf_resize(ctx, 1001) == RBUF_ERR_BAD_SIZE);
+    TEST_CHECK(rbuf_del(ctx) == RBUF_OK);
+
+    conf.flags = RBUF_FLAG_MMAP;
+    TEST_CHECK(rbuf_new(&ctx, &conf) == RBUF_OK);
+    TEST_CHECK(rbuf_append(ctx, "123456789", 9) == RBUF_OK);
+    TEST_CHECK(rbuf_del(ctx) == RBUF_OK);
+
+    TEST_CHECK(fstat(0, &st) == 0);
+    TEST_CHECK(st.st_size == 0);
+
+    TEST_CHECK(dup2(fd, 0) == 0);
+    TEST_CHECK(close(fd) == 0);
+    TEST_CHECK(fclose(file) == 0);
+}
+
+/* the blocks mapped from a file go out with sendfile(), the written data
+   is consumed, and the file is left holding the rest. */
+static void test_write_fd_mapped(void) {
+    static const test_mode mode = {"write-fd-mapped", RBUF_FLAG_MMAP, 0, 0, false, 0, 0, 0};
+    static rbuf_u8 data[3 * TEST_DATA_SIZE];
+    static rbuf_u8 back[3 * TEST_DATA_SIZE];
+    struct stat st;
+    rbuf_ctx *ctx;
+    rbuf_conf conf;
+    rbuf_u32 done;
+    rbuf_u32 num;
+    FILE *file;
+    int fds[2];
+
+    test_mode_curt = &mode;
+    test_block_size = test_block_sizes[0];
+    test_op_idx = 0;
+
+    for (size_t i = 0; i < sizeof(data); i++) {
+        data[i] = (rbuf_u8)rand();
+    }
+
+    file = tmpfile();
+    TEST_CHECK(file != NULL);
+    TEST_CHECK(pipe(fds) == 0);
+
+    rbuf_conf_init(&conf);
+    conf.block_size = test_block_size;
+    conf.size_max = 0;
+    conf.flags = RBUF_FLAG_MMAP;
+    conf.map_fd = fileno(file);
+    TEST_CHECK(rbuf_new(&ctx, &conf) == RBUF_OK);
+    TEST_CHECK(rbuf_append(ctx, data, sizeof(data)) == RBUF_OK);
+
+    for (num = 0; num < 2 * TEST_DATA_SIZE; num += done) {
+        TEST_CHECK(rbuf_write_fd(ctx, fds[1], 2 * TEST_DATA_SIZE - num, &done) == RBUF_OK);
+        TEST_CHECK(done != 0);
+    }
+    TEST_CHECK(read(fds[0], back, 2 * TEST_DATA_SIZE) == 2 * TEST_DATA_SIZE);
+    TEST_CHECK(memcmp(back, data, 2 * TEST_DATA_SIZE) == 0);
+
+    TEST_CHECK(rbuf_copy_to(ctx, back, 0, TEST_DATA_SIZE) == RBUF_OK);
+    TEST_CHECK(memcmp(back, data + 2 * TEST_DATA_SIZE, TEST_DATA_SIZE) == 0);
+    TEST_CHECK(rbuf_del(ctx) == RBUF_OK);
+
+    TEST_CHECK(fstat(fileno(file), &st) == 0);
+    TEST_CHECK(st.st_size == TEST_DATA_SIZE);
+    TEST_CHECK(pread(fileno(file), back, TEST_DATA_SIZE, 0) == TEST_DATA_SIZE);
+    TEST_CHECK(memcmp(back, data + 2 * TEST_DATA_SIZE, TEST_DATA_SIZE) == 0);
+
+    TEST_CHECK(close(fds[0]) == 0);
+    TEST_CHECK(close(fds[1]) == 0);
+    TEST_CHECK(fclose(file) == 0);
+}
+
+static void *test_plain_alloc(void *user, size_t size) {
+    (void)user;
+
+    return malloc(size);
+}
+
+static void test_plain_free(void *user, void *ptr) {
+    (void)user;
+
+    free(ptr);
+}
+
+/* the blocks are aligned as asked, with the default allocator and with a
+   custom one, a slab chunk of a huge page or more is aligned to it, and
+   the configurations which can't align the blocks are refused. */
+static void test_align(void) {
+    static const test_mode mode = {"align", RBUF_FLAG_HUGE_PAGE, 0, 0, false, 0, 0, 0};
+    static rbuf_u8 data[TEST_DATA_SIZE];
+    rbuf_u32 huge_size;
+    rbuf_iovec iov[1];
+    int iovcnt;
+    int diff;
+    rbuf_ctx *ctx;
+    rbuf_conf conf;
+    rbuf_stat stat;
+
+    test_mode_curt = &mode;
+    test_op_idx = 0;
+
+    for (size_t i = 0; i < sizeof(data); i++) {
+        data[i] = (rbuf_u8)rand();
+    }
+
+    /* 2 MiB blocks, or slab chunks of them with the block size fixed. */
+    huge_size = 2 * 1024 * 1024;
+    rbuf_conf_init(&conf);
+#ifdef RBUF_BLOCK_SHIFT
+    conf.block_size = (rbuf_u32)1 << RBUF_BLOCK_SHIFT;
+    conf.slab_block_num = huge_size / conf.block_size;
+#else
+    conf.block_size = huge_size;
+#endif
+    test_block_size = conf.block_size;
+    conf.size_max = 0;
+    conf.flags = RBUF_FLAG_HUGE_PAGE | RBUF_FLAG_SHARED;
+
+    for (int custom = 0; custom < 2; custom++) {
+        if (custom != 0) {
+            conf.mem.alloc = test_plain_alloc;
+            conf.mem.free = test_plain_free;
+        }
+
+        TEST_CHECK(rbuf_new(&ctx, &conf) == RBUF_OK);
+        TEST_CHECK(rbuf_resize64(ctx, (rbuf_u64)3 * huge_size) == RBUF_OK);
+        TEST_CHECK(rbuf_status(ctx, &stat) == RBUF_OK);
+        TEST_CHECK(stat.block_align >= ((conf.block_size < huge_size) ? conf.block_size : huge_size));
+
+        /* the chunks start on a huge page. */
+        for (rbuf_u32 i = 0; i < 3; i++) {
+            iovcnt = 1;
+            TEST_CHECK(rbuf_peek_iov(ctx, i * huge_size, 1, iov, &iovcnt) == RBUF_OK);
+            TEST_CHECK(((uintptr_t)iov[0].iov_base & (huge_size - 1)) == 0);
+        }
+
+        /* the data crosses the chunks. */
+        TEST_CHECK(rbuf_copy_from(ctx, data, huge_size - 100, sizeof(data)) == RBUF_OK);
+        TEST_CHECK(rbuf_compare(ctx, data, huge_size - 100, sizeof(data), &diff) == RBUF_OK);
+        TEST_CHECK(diff == 0);
+
+        TEST_CHECK(rbuf_resize(ctx, 1) == RBUF_OK);
+        TEST_CHECK(rbuf_del(ctx) == RBUF_OK);
+    }
+
+    /* smaller alignments, again with both allocators. */
+    rbuf_conf_init(&conf);
+    conf.block_size = test_block_sizes[0];
+    conf.size_max = 0;
+    conf.block_align = 4096;
+    test_block_size = conf.block_size;
+    for (int custom = 0; custom < 2; custom++) {
+        if (custom != 0) {
+            conf.mem.alloc = test_plain_alloc;
+            conf.mem.free = test_plain_free;
+        }
+
+        TEST_CHECK(rbuf_new(&ctx, &conf) == RBUF_OK);
+        TEST_CHECK(rbuf_append(ctx, data, sizeof(data)) == RBUF_OK);
+        TEST_CHECK(rbuf_status(ctx, &stat) == RBUF_OK);
+        TEST_CHECK(stat.block_align >= 4096);
+        TEST_CHECK(rbuf_del(ctx) == RBUF_OK);
+    }
+
+    /* the alignments which can't be, or can't be kept. */
+    rbuf_conf_init(&conf);
+    conf.block_size = test_block_sizes[0];
+    conf.block_align = 48;
+    TEST_CHECK(rbuf_new(&ctx, &conf) == RBUF_ERR_BAD_SIZE);
+
+    conf.block_align = 64;
+    conf.flags = RBUF_FLAG_MMAP;
+    TEST_CHECK(rbuf_new(&ctx, &conf) == RBUF_ERR);
+    conf.flags = RBUF_FLAG_RECYCLE;
+    TEST_CHECK(rbuf_new(&ctx, &conf) == RBUF_ERR);
+    conf.flags = 0;
+    conf.pool = test_pools[0].data;
+    conf.pool_size = TEST_POOL_SIZE;
+    TEST_CHECK(rbuf_new(&ctx, &conf) == RBUF_ERR);
+
+#ifndef RBUF_BLOCK_SHIFT
+    conf.pool = NULL;
+    conf.pool_size = 0;
+    conf.block_size = 100;
+    conf.slab_block_num = 2;
+    TEST_CHECK(rbuf_new(&ctx, &conf) == RBUF_ERR_BAD_SIZE);
+#endif
+}
+
+/* the counting allocator tells the blocks by their size, which can't be
+   96 bytes with the block size fixed at compile time. */
+#ifndef RBUF_BLOCK_SHIFT
+
+/* number of the blocks of 96 bytes the counting allocator gave out and
+   which aren't freed yet, no other memory of the buffer has that size. */
+static rbuf_u32 test_live_num;
+static void *test_live[64];
+
+static void *test_count_alloc(void *user, size_t size) {
+    void *ptr;
+
+    (void)user;
+
+    ptr = malloc(size);
+    if (ptr != NULL &&
+        size == 96) {
+        TEST_CHECK(test_live_num < sizeof(test_live) / sizeof(test_live[0]));
+        test_live[test_live_num++] = ptr;
+    }
+
+    return ptr;
+}
+
+static void test_count_free(void *user, void *ptr) {
+    (void)user;
+
+    for (rbuf_u32 i = 0; i < test_live_num; i++) {
+        if (test_live[i] == ptr) {
+            test_live[i] = test_live[--test_live_num];
+            break;
+        }
+    }
+
+    free(ptr);
+}
+
+/* the chunks released by shrinking are kept up to the high watermark, then
+   dropped down to the low one in one go, and reused before any new one. */
+static void test_spare(void) {
+    static const test_mode mode = {"spare-watermarks", 0, 0, 0, false, 2, 4, 0};
+    rbuf_ctx *ctx;
+    rbuf_conf conf;
+    rbuf_u32 block_size;
+
+    test_mode_curt = &mode;
+    test_op_idx = 0;
+
+    rbuf_conf_init(&conf);
+    block_size = 96;
+    test_block_size = block_size;
+    conf.block_size = block_size;
+    conf.spare_low = mode.spare_low;
+    conf.spare_high = mode.spare_high;
+    conf.mem.alloc = test_count_alloc;
+    conf.mem.free = test_count_free;
+    TEST_CHECK(rbuf_new(&ctx, &conf) == RBUF_OK);
+
+    TEST_CHECK(rbuf_resize(ctx, 10 * block_size) == RBUF_OK);
+    TEST_CHECK(test_live_num == 10);
+
+    /* the 5th, 7th and 9th released chunks each find 4 spare ones,
+       so 2 are freed every time, and 4 are left. */
+    TEST_CHECK(rbuf_resize(ctx, 0) == RBUF_OK);
+    TEST_CHECK(test_live_num == 4);
+
+    /* the spare ones come first. */
+    TEST_CHECK(rbuf_resize(ctx, 4 * block_size) == RBUF_OK);
+    TEST_CHECK(test_live_num == 4);
+    TEST_CHECK(rbuf_resize(ctx, 5 * block_size) == RBUF_OK);
+    TEST_CHECK(test_live_num == 5);
+
+    /* 3 spare ones below the high watermark are kept, until trimmed. */
+    TEST_CHECK(rbuf_resize(ctx, 2 * block_size) == RBUF_OK);
+    TEST_CHECK(test_live_num == 5);
+    TEST_CHECK(rbuf_trim(ctx) == RBUF_OK);
+    TEST_CHECK(test_live_num == 2);
+
+    TEST_CHECK(rbuf_del(ctx) == RBUF_OK);
+    TEST_CHECK(test_live_num == 0);
+}
+
+#endif
+
+#ifdef RBUF_BLOCK_SHIFT
+
+/* the block size fixed at compile time is the only one taken, and the
+   adaptive mode, which changes it, is refused. */
+static void test_block_shift(void) {
+    static const test_mode mode = {"block-shift", 0, 0, 0, false, 0, 0, 0};
+    rbuf_ctx *ctx;
+    rbuf_conf conf;
+    rbuf_stat stat;
+
+    test_mode_curt = &mode;
+    test_block_size = (rbuf_u32)1 << RBUF_BLOCK_SHIFT;
+    test_op_idx = 0;
+
+    rbuf_conf_init(&conf);
+    conf.block_size = 0;
+    TEST_CHECK(rbuf_new(&ctx, &conf) == RBUF_OK);
+    TEST_CHECK(rbuf_resize(ctx, 3 * test_block_size + 1) == RBUF_OK);
+    TEST_CHECK(rbuf_status(ctx, &stat) == RBUF_OK);
+    TEST_CHECK(stat.block_num == 4 || RBUF_INLINE_SIZE >= 3 * test_block_size + 1);
+    TEST_CHECK(rbuf_del(ctx) == RBUF_OK);
+
+    conf.block_size = test_block_size * 2;
+    TEST_CHECK(rbuf_new(&ctx, &conf) == RBUF_ERR_BAD_SIZE);
+
+    conf.block_size = test_block_size;
+    conf.block_size_max = test_block_size * 8;
+    TEST_CHECK(rbuf_new(&ctx, &conf) == RBUF_ERR_BAD_SIZE);
+}
+
+#endif
+
+int main(int argc, char *argv[]) {
+    rbuf_u32 op_num;
+    rbuf_u32 seed;
+
+    op_num = TEST_OP_NUM;
+    if (argc > 1) {
+        op_num = (rbuf_u32)strtoul(argv[1], NULL, 10);
+    }
+
+    test_checksum_basics();
+    test_conf_zero();
+    test_write_fd_mapped();
+    test_align();
+#ifdef RBUF_BLOCK_SHIFT
+    test_block_shift();
+#else
+    test_spare();
+#endif
+
+    seed = 1;
+    for (size_t i = 0; i < sizeof(test_modes) / sizeof(test_modes[0]); i++) {
+        test_mode_curt = &test_modes[i];
+
+#ifdef RBUF_BLOCK_SHIFT
+        if (test_mode_curt->block_size_max != 0) {
+            continue;
+        }
+#endif
+
+        for (size_t j = 0; j < sizeof(test_block_sizes) / sizeof(test_block_sizes[0]); j++) {
+            test_block_size = test_block_sizes[j];
+            if (test_mode_curt->block_size_max != 0 &&
+                (test_block_size & (test_block_size - 1)) != 0) {
+                continue;
+            }
+
+            if (test_mode_curt->pool &&
+                test_block_size < sizeof(void *)) {
+                continue;
+            }
+
+            srand(seed++);
+            test_run(op_num);
+        }
+
+        printf("%s: ok\n", test_mode_curt->name);
+    }
+
+    return EXIT_SUCCESS;
+}